@@ -30,11 +30,13 @@
 #include <ic_bitmap.h>
 #include <ic_dyn_array.h>
 #include <ic_hashtable.h>
+#include <ic_oa_hashtable.h>
 #include <ic_connection.h>
 #include <ic_protocol_support.h>
 #include <ic_sock_buf.h>
 #include <ic_poll_set.h>
 #include <ic_threadpool.h>
+#include <ic_hw_info.h>
 #include <ic_apic.h>
 #include <ic_apid.h>
 #include "ic_apid_general_signals.h"
@@ -73,3 +75,7 @@
 /* Data API internals */
 #include "ic_apid_handle_dict_messages.ic"
 #include "ic_apid_handle_message_array.ic"
+#ifdef WITH_UNIT_TEST
+/* Unit tests of the Data API internals */
+#include "ic_apid_unit_test.ic"
+#endif
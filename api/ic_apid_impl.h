@@ -22,6 +22,9 @@ typedef struct ic_ndb_message IC_NDB_MESSAGE;
 typedef struct ic_temp_thread_connection IC_TEMP_THREAD_CONNECTION;
 typedef struct ic_receive_node_connection IC_RECEIVE_NODE_CONNECTION;
 typedef struct ic_message_error_object IC_MESSAGE_ERROR_OBJECT;
+typedef struct ic_thread_ring IC_THREAD_RING;
+typedef struct ic_thread_ring_entry IC_THREAD_RING_ENTRY;
+typedef struct ic_send_delay_histogram IC_SEND_DELAY_HISTOGRAM;
 
 int ic_poll_messages(IC_APID_CONNECTION *apid_conn, glong wait_time);
 int ic_send_messages(IC_APID_CONNECTION *apid_conn, gboolean force_send);
@@ -34,6 +37,11 @@ struct ic_message_error_object
   IC_ERROR_SEVERITY_LEVEL error_severity;
 };
 
+/* Number of receive pages provided to a poll set that reads by itself */
+#define IC_NUM_READ_PAGES 16
+/* Max number of send buffer areas registered with a poll set */
+#define IC_MAX_SEND_BUFFER_AREAS 64
+
 struct ic_ndb_receive_state
 {
   /* Global data for Data Server API */
@@ -46,6 +54,8 @@ struct ic_ndb_receive_state
   IC_SOCK_BUF *rec_buf_pool;
   /* Reference to global pool of NDB messages */
   IC_SOCK_BUF *message_pool;
+  /* NUMA node receive thread is bound to, NULL if not bound */
+  IC_APID_NUMA_NODE *numa_node;
   /* Poll set used by this receive thread */
   IC_POLL_SET *poll_set;
   /*
@@ -56,15 +66,46 @@ struct ic_ndb_receive_state
   IC_SEND_NODE_CONNECTION *first_add_node;
   IC_SEND_NODE_CONNECTION *first_rem_node;
   IC_SEND_NODE_CONNECTION *first_send_node;
-  /* 
-    Statistical info to track usage of this socket to enable proper
-    configuration of threads to handle NDB Protocol.
-    Not created yet.
+  /*
+    Statistical info to track usage of the sockets to enable moving nodes
+    between the receive threads of a cluster. The load is the load of the
+    last measurement period, it's protected by the apid_global mutex. The
+    number of nodes counts all nodes that refer to this receive thread,
+    it's protected by the mutex on this record.
   */
+  IC_TIMER last_reorg_check;
+  guint64 load;
+  guint32 num_nodes;
+  /*
+    A node being moved to another receive thread has been removed from
+    our poll set, it's handed over to the target receive thread when all
+    user threads have consumed the messages we posted before the move.
+    This ensures that messages from one node are never reordered. The
+    ring heads are recorded per thread connection when all messages
+    received before the move have been posted.
+    Only accessed by the receive thread itself.
+  */
+  IC_SEND_NODE_CONNECTION *migrate_node;
+  IC_NDB_RECEIVE_STATE *migrate_target;
+  gboolean migrate_heads_recorded;
+  IC_THREAD_RING *migrate_rings[IC_MAX_THREAD_CONNECTIONS];
+  gint migrate_ring_heads[IC_MAX_THREAD_CONNECTIONS];
   /* Thread id in receive thread pool of receiver thread */
   guint32 thread_id;
   /* Cluster id handled by this receiver thread */
   guint32 cluster_id;
+  /* Number of asynchronous sends started and not yet completed */
+  guint32 num_async_sends;
+  /* Send buffer areas are registered with the poll set at first send */
+  gboolean send_buffers_registered;
+  /*
+    Pages provided to the poll set when it reads from the sockets by
+    itself, indexed by buffer id. The read returned while busy polling is
+    handled before the reads returned by the poll set afterwards.
+  */
+  gboolean async_read;
+  IC_SOCK_BUF_PAGE *read_pages[IC_NUM_READ_PAGES];
+  const IC_POLL_READ *first_read;
 
   IC_MUTEX *mutex;
   IC_COND *cond;
@@ -75,14 +116,26 @@ struct ic_ndb_receive_state
 #define IC_MESSAGE_FRAGMENT_INTERMEDIATE 2
 #define IC_MESSAGE_FRAGMENT_LAST 3
 
+/*
+  The opaque area is stored in the IC_SOCK_BUF_PAGE object of the NDB
+  message. buf_page is the receive page the message data resides in when
+  the message wasn't copied, it's NULL for short copied messages.
+
+  packed_message is 0 for normal messages. For messages extracted from a
+  message sent to IC_NDB_PACKED_MODULE_ID it is the word offset of the
+  header word of the extracted message inside the packed message. The
+  packed message header word contains the number of data words minus 3 in
+  Bit 0-4 and the receiver module id in Bit 16-31.
+*/
 struct ic_ndb_message_opaque_area
 {
   IC_SEND_NODE_CONNECTION *send_node_conn;
+  IC_SOCK_BUF_PAGE *buf_page;
   guint32 sender_node_id;
   guint32 receiver_node_id;
   guint32 cluster_id;
-  guint32 packed_message;
-  guint32 version_num; /* Always 0 currently */
+  guint16 packed_message;
+  guint16 version_num; /* Always 0 currently */
 };
 
 struct ic_ndb_message
@@ -138,14 +191,55 @@ struct ic_ndb_message
   guint32 sender_node_id;
   guint32 receiver_node_id;
   guint32 cluster_id;
+  /*
+    The receive page of long messages, their data is read directly from
+    this page. NULL for short messages which were copied.
+  */
+  IC_SOCK_BUF_PAGE *buf_page;
+};
+
+/*
+  NDB messages are handed from a receive thread to a user thread through a
+  single-producer/single-consumer ring. There is one ring per pair of
+  receive thread and user thread, the ring is allocated by the receive
+  thread the first time it delivers messages to the user thread. Each
+  entry in the ring is a linked list of NDB messages.
+
+  The head is only written by the receive thread and the tail is only
+  written by the user thread, they are kept in separate cache lines to
+  avoid false sharing. When the ring is full the receive thread keeps the
+  messages and retries delivering them after its next receive.
+*/
+#define IC_THREAD_RING_SIZE 128
+#define IC_THREAD_RING_MASK (IC_THREAD_RING_SIZE - 1)
+
+struct ic_thread_ring_entry
+{
+  IC_SOCK_BUF_PAGE *first_message;
+  IC_SOCK_BUF_PAGE *last_message;
+};
+
+struct ic_thread_ring
+{
+  gint head;
+  gchar head_pad[IC_STD_CACHE_LINE_SIZE - sizeof(gint)];
+  gint tail;
+  gchar tail_pad[IC_STD_CACHE_LINE_SIZE - sizeof(gint)];
+  IC_THREAD_RING_ENTRY entries[IC_THREAD_RING_SIZE];
 };
 
 struct ic_thread_connection
 {
-  IC_SOCK_BUF_PAGE *first_received_message;
-  IC_SOCK_BUF_PAGE *last_received_message;
+  /* Rings indexed by thread id of receive thread */
+  IC_THREAD_RING *rings[IC_MAX_RECEIVE_THREADS + 1];
   IC_INT_APID_CONNECTION *apid_conn;
-  gboolean thread_wait_cond;
+  /*
+    Set by the user thread before it goes to sleep on the condition, the
+    receive thread only takes the mutex and signals the condition when
+    this flag is set. Thus the mutex and condition are only used when the
+    user thread actually sleeps.
+  */
+  gint thread_wait_cond;
   IC_MUTEX *mutex;
   IC_COND *cond;
 };
@@ -181,8 +275,6 @@ struct ic_receive_node_connection
   IC_SOCK_BUF_PAGE *buf_page;
   /* How many bytes have been received into the current receive page */
   guint32 read_size;
-  /* Have we received a full header of the NDB message in the receive page */
-  gboolean read_header_flag;
   /* Cluster id of this connection */
   guint32 cluster_id;
   /* Node id of the node on the other end of the socket connection */
@@ -191,13 +283,61 @@ struct ic_receive_node_connection
   guint32 my_node_id;
   /* Send node connection for the node */
   IC_SEND_NODE_CONNECTION *send_node_conn;
+  /*
+    Bytes and messages received in the current measurement period and the
+    load of the node in the last period, used to balance nodes between
+    receive threads. Only accessed by the receive thread.
+  */
+  guint64 num_bytes_received;
+  guint32 num_messages_received;
+  guint64 load;
+};
+
+/*
+  Events recorded in the per-thread trace ring of debug builds through
+  DEBUG_TRACE. The trace ring replaces printouts in the receive, execute
+  and send path, it is written in binary form and formatted only when
+  dumped at thread exit.
+*/
+#define IC_TRACE_NDB_RECEIVE 1 /* Node id, bytes read */
+#define IC_TRACE_NDB_EXECUTE 2 /* Message id, sender node id */
+#define IC_TRACE_NDB_SEND 3 /* Node id, bytes sent */
+#define IC_TRACE_NDB_ASYNC_SEND 4 /* Node id, bytes sent */
+
+/*
+  Log-linear histogram of send delays in nanoseconds used by the adaptive
+  send algorithm. Delays below 2^IC_SEND_HIST_MIN_SHIFT nanoseconds go into
+  bucket 0, each power of two above this is split into
+  IC_SEND_HIST_SUB_BUCKETS buckets of equal size and delays beyond the
+  last power of two go into the last bucket. This gives a relative error
+  of at most 25% on percentiles over the range 1 microsecond to 67
+  milliseconds.
+*/
+#define IC_SEND_HIST_MIN_SHIFT 10
+#define IC_SEND_HIST_NUM_SHIFTS 16
+#define IC_SEND_HIST_SUB_SHIFT 2
+#define IC_SEND_HIST_SUB_BUCKETS (1 << IC_SEND_HIST_SUB_SHIFT)
+#define IC_SEND_HIST_BUCKETS \
+  ((IC_SEND_HIST_NUM_SHIFTS * IC_SEND_HIST_SUB_BUCKETS) + 2)
+/* Age the histogram by halving it when it has this many samples */
+#define IC_SEND_HIST_MAX_SAMPLES 1024
+/* Number of new samples needed before the algorithm reconsiders */
+#define IC_SEND_HIST_DECISION_SAMPLES 32
+
+struct ic_send_delay_histogram
+{
+  guint32 num_samples;
+  guint32 buckets[IC_SEND_HIST_BUCKETS];
 };
 
 struct ic_send_node_connection
 {
   /* A pointer to the global struct */
   IC_INT_APID_GLOBAL *apid_global;
-  /* Receive thread object if connected to one at the moment */
+  /*
+    Receive thread object if connected to one at the moment, changed with
+    both the mutex of the receive thread and the mutex of this object held.
+  */
   IC_NDB_RECEIVE_STATE *rec_state;
   /* Receive node object */
   IC_RECEIVE_NODE_CONNECTION rec_node;
@@ -242,8 +382,29 @@ struct ic_send_node_connection
   /* Linked list of send buffers awaiting sending */
   IC_SOCK_BUF_PAGE *first_sbp;
   IC_SOCK_BUF_PAGE *last_sbp;
+  /*
+    Page currently being filled with messages by send_message, it isn't
+    part of the list of send buffers until it's sealed. It is sealed when
+    it's full or when a sender decides to send.
+  */
+  IC_SOCK_BUF_PAGE *open_sbp;
   /* List of buffers to release after sending completed */
   IC_SOCK_BUF_PAGE *release_sbp;
+  /*
+    When the receive thread sends asynchronously through its poll set the
+    buffers being sent are kept here until the write has completed. The
+    write vector is kept to be able to continue after a partial write.
+  */
+  IC_SOCK_BUF_PAGE *async_sbp;
+  IC_IOVEC async_write_vector[IC_MAX_SEND_BUFFERS];
+  guint32 async_iovec_size;
+  guint32 async_send_size;
+  /*
+    Poll set used by the send thread to send asynchronously, NULL if
+    the poll set can't write asynchronously. Only used by the send thread.
+  */
+  IC_POLL_SET *send_poll_set;
+  gboolean send_buffers_registered;
 
   /* How many bytes are in the send buffers awaiting sending */
   guint32 queued_bytes;
@@ -344,12 +505,15 @@ struct ic_send_node_connection
   */
   guint32 num_waits;
   guint32 max_num_waits;
-  /* Number of statistical entries */
-  guint32 num_stats;
-  /* Sum of waits with current state */
-  IC_TIMER tot_curr_wait_time;
-  /* Sum of waits if we added one to the state */
-  IC_TIMER tot_wait_time_plus_one;
+  /* Number of samples since the algorithm last reconsidered its state */
+  guint32 num_new_samples;
+  /* 95th and 99th percentile of send delay at last decision */
+  IC_TIMER p95_wait_time;
+  IC_TIMER p99_wait_time;
+  /* Histogram of send delays with current state */
+  IC_SEND_DELAY_HISTOGRAM curr_wait_hist;
+  /* Histogram of send delays if we added one to the state */
+  IC_SEND_DELAY_HISTOGRAM plus_one_wait_hist;
   /* Index into timer array */
   guint32 last_send_timer_index;
   /*
@@ -377,6 +541,12 @@ static gboolean check_node_started(IC_SEND_NODE_CONNECTION *send_node_conn);
 struct ic_cluster_comm
 {
   IC_SEND_NODE_CONNECTION **send_node_conn_array;
+  /*
+    Latency budget of the adaptive send algorithm for all nodes in the
+    cluster, overrides the configured socket_max_wait_in_nanos when set.
+  */
+  IC_TIMER send_latency_budget;
+  gboolean use_send_latency_budget;
 };
 
 struct ic_grid_comm
@@ -386,8 +556,10 @@ struct ic_grid_comm
 };
 
 static IC_NDB_RECEIVE_STATE*
-get_first_receive_thread(IC_INT_APID_GLOBAL *apid_global,
-                         guint32 cluster_id);
+get_least_loaded_receive_thread(IC_INT_APID_GLOBAL *apid_global,
+                                guint32 cluster_id);
+static IC_NDB_RECEIVE_STATE*
+lock_node_receive_thread(IC_SEND_NODE_CONNECTION *send_node_conn);
 
 static IC_SEND_NODE_CONNECTION*
 get_send_node_conn(IC_INT_APID_GLOBAL *apid_global,
@@ -40,13 +40,26 @@ typedef struct ic_int_metadata_transaction IC_INT_METADATA_TRANSACTION;
 
 typedef struct ic_int_transaction IC_INT_TRANSACTION;
 typedef struct ic_int_apid_query IC_INT_APID_QUERY;
+typedef struct ic_int_scan_fragment IC_INT_SCAN_FRAGMENT;
 typedef struct ic_int_apid_error IC_INT_APID_ERROR;
 typedef struct ic_int_apid_connection IC_INT_APID_CONNECTION;
 typedef struct ic_int_apid_global IC_INT_APID_GLOBAL;
 typedef struct ic_apid_cluster_data IC_APID_CLUSTER_DATA;
 typedef struct ic_int_table_def IC_INT_TABLE_DEF;
+typedef struct ic_table_cache IC_TABLE_CACHE;
+typedef struct ic_table_cache_entry IC_TABLE_CACHE_ENTRY;
+typedef struct ic_apid_numa_node IC_APID_NUMA_NODE;
 typedef struct ic_int_range_condition IC_INT_RANGE_CONDITION;
+typedef struct ic_int_range IC_INT_RANGE;
+typedef struct ic_int_range_part IC_INT_RANGE_PART;
 typedef struct ic_int_where_condition IC_INT_WHERE_CONDITION;
+typedef struct ic_int_where_memory IC_INT_WHERE_MEMORY;
+typedef struct ic_int_where_subroutine IC_INT_WHERE_SUBROUTINE;
+typedef enum ic_where_memory_type IC_WHERE_MEMORY_TYPE;
+typedef enum ic_where_subroutine_type IC_WHERE_SUBROUTINE_TYPE;
+typedef struct ic_like_matcher IC_LIKE_MATCHER;
+typedef struct ic_where_row_batch IC_WHERE_ROW_BATCH;
+typedef struct ic_record_pages IC_RECORD_PAGES;
 
 typedef enum ic_apid_query_list_type IC_APID_QUERY_LIST_TYPE;
 
@@ -74,6 +87,47 @@ struct ic_int_transaction
   /* Internal part */
   IC_INT_APID_QUERY *first_trans_query;
   IC_INT_APID_QUERY *last_trans_query;
+  /* Data API connection which started the transaction */
+  IC_INT_APID_CONNECTION *apid_conn;
+  guint32 cluster_id;
+  /* Node id of the data node where the transaction coordinator resides */
+  guint32 tc_node_id;
+  /* Our reference to the transaction, index into trans_bindings */
+  guint32 my_trans_ref;
+  /* NDB reference to the transaction record, valid when is_connected */
+  guint32 ndb_trans_ref;
+  gboolean is_connected;
+  /* Error code from NDB_CONNECTREF, no queries can be sent when set */
+  int connect_error;
+  /*
+    Set when the user has sent queries of the transaction before
+    NDB_CONNECTCONF arrived, these are sent when it arrives.
+  */
+  gboolean has_waiting_queries;
+  /* Set when the query with the start transaction flag has been sent */
+  gboolean is_started_in_ndb;
+  /*
+    The last query of this transaction in the defined list, this query
+    will be sent with the execute flag set.
+  */
+  IC_INT_APID_QUERY *last_defined_query;
+  /*
+    Number of queries of the transaction defined and not yet completed,
+    the transaction can't end before all its queries are completed.
+  */
+  guint32 num_active_queries;
+  /* Callback when the transaction has ended after commit or rollback */
+  IC_APID_CALLBACK_FUNC callback_func;
+  void *user_reference;
+  /* Set when the user has requested commit or rollback */
+  gboolean is_end_requested;
+  /*
+    Set when NDB_COMMITREQ or NDB_ABORTREQ has been sent or the commit
+    flag was set on a query, we wait for the outcome from NDB.
+  */
+  gboolean is_end_sent;
+  gboolean in_end_trans_list;
+  IC_INT_TRANSACTION *next_end_trans;
 };
 
 enum ic_apid_query_list_type
@@ -191,34 +245,210 @@ struct ic_int_table_def
   guint32 num_key_fields;
   guint32 num_null_fields;
   guint32 cluster_id;
+  /*
+    The nodes storing the replicas of each partition, num_replicas nodes
+    per partition with the primary replica first. Used to select the
+    transaction coordinator of a transaction on a key.
+  */
+  guint32 num_partitions;
+  guint32 num_replicas;
+  guint32 num_hash_map_buckets;
+  guint16 *partition_nodes;
 
   int ret_code;
-  guint32 ref_count;
+  /*
+    The reference count is updated with atomic operations since the
+    lock-free lookup in the table cache takes references without holding
+    the cluster data mutex.
+  */
+  volatile gint ref_count;
   IC_MD_TABLE_CREATE_STATE create_state;
   volatile gboolean valid;
+  /* Search name (schema, database and table name), key in the hash tables */
+  IC_STRING md_name;
 
   gboolean is_index;
   gboolean is_unique_index;
   IC_BITMAP *key_fields;
   guint32 *key_field_id_order;
   IC_FIELD_DEF **fields;
-  IC_HASHTABLE *field_hash;
+  IC_OA_HASHTABLE *field_hash;
   IC_MEMORY_CONTAINER *mc_ptr;
 
   IC_INT_APID_CONNECTION *first_wait_get_table;
   IC_INT_APID_CONNECTION *last_wait_get_table;
 };
 
+/*
+  One part of a range is the lower and upper bound on one field of the
+  ordered index. A NULL start_ptr or end_ptr means the bound value is NULL,
+  IC_NO_MINIMUM and IC_NO_MAXIMUM means there is no bound on the field.
+*/
+struct ic_int_range_part
+{
+  guint32 field_id;
+  gchar *start_ptr;
+  guint32 start_len;
+  gchar *end_ptr;
+  guint32 end_len;
+  IC_LOWER_RANGE_TYPE lower_range_type;
+  IC_UPPER_RANGE_TYPE upper_range_type;
+};
+
+struct ic_int_range
+{
+  IC_INT_RANGE_PART *parts;
+  guint32 num_parts;
+  /* Partitions the range can be found in, NULL if not known */
+  IC_BITMAP *partition_bitmap;
+};
+
 struct ic_int_range_condition
 {
   IC_RANGE_CONDITION_OPS *range_ops;
-  guint32 not_used;
+  IC_MEMORY_CONTAINER *mc_ptr;
+  IC_INT_RANGE *ranges;
+  guint32 num_ranges;
+  /* Ranges must be defined in order, this is the last range defined */
+  guint32 last_range_id;
+  /* Maximum number of parts in a range, the number of index fields */
+  guint32 max_parts;
+  /*
+    The ranges encoded as bounds in the format sent in the key info of
+    NDB_SCANREQ, prepared when the scan is defined.
+  */
+  guint32 *range_info;
+  guint32 num_range_info_words;
+};
+
+/*
+  A WHERE condition is kept as the tree of subroutines and memory addresses
+  it was defined with until it's compiled into an interpreted program for
+  the table of the query using it.
+*/
+enum ic_where_memory_type
+{
+  IC_WHERE_FIELD_MEMORY= 0,
+  IC_WHERE_CONST_MEMORY= 1,
+  IC_WHERE_CALCULATION_MEMORY= 2
+};
+
+struct ic_int_where_memory
+{
+  IC_WHERE_MEMORY_TYPE memory_type;
+  guint32 field_id;
+  /* A NULL const_ptr is a NULL constant */
+  gchar *const_ptr;
+  guint32 const_len;
+  IC_FIELD_TYPE const_type;
+  guint32 left_memory_address;
+  guint32 right_memory_address;
+  IC_CALCULATION_TYPE calc_type;
+};
+
+enum ic_where_subroutine_type
+{
+  IC_WHERE_SUB_NOT_DEFINED= 0,
+  IC_WHERE_SUB_BOOLEAN= 1,
+  IC_WHERE_SUB_CONDITION= 2,
+  IC_WHERE_SUB_NOT= 3,
+  IC_WHERE_SUB_FIRST= 4,
+  IC_WHERE_SUB_REGEXP= 5,
+  IC_WHERE_SUB_LIKE= 6
+};
+
+struct ic_int_where_subroutine
+{
+  IC_WHERE_SUBROUTINE_TYPE subroutine_type;
+  IC_BOOLEAN_TYPE boolean_type;
+  IC_COMPARATOR_TYPE comp_type;
+  /* Subroutine ids for boolean, not and first, memory addresses otherwise */
+  guint32 left_id;
+  guint32 right_id;
+  /* Field and part of it used by regexp and like */
+  guint32 field_id;
+  guint32 start_pos;
+  guint32 end_pos;
+  /* Precompiled pattern of regexp and like */
+  GRegex *regex;
+  IC_LIKE_MATCHER *like_matcher;
+};
+
+/*
+  A LIKE pattern with the escapes removed, each pattern byte has a type
+  that is either a literal byte, _ or %.
+*/
+#define IC_LIKE_LITERAL 0
+#define IC_LIKE_ANY_ONE 1
+#define IC_LIKE_ANY_SEQUENCE 2
+
+struct ic_like_matcher
+{
+  guint8 *pattern;
+  guint8 *pattern_type;
+  guint32 pattern_len;
+};
+
+/*
+  A batch of records to evaluate a WHERE condition on in the API, each
+  record is stored as the buffer values and null bits of the query.
+*/
+struct ic_where_row_batch
+{
+  guint64 *values;
+  guint8 *null_bits;
+  guint32 num_rows;
+  guint32 max_rows;
+  guint32 values_per_row;
+  guint32 null_bytes_per_row;
+};
+
+/*
+  Variable sized fields of received records aren't copied, the buffer
+  values point into the receive pages instead. The pages referenced are
+  kept by incrementing their reference count until the records are no
+  longer used. Records received in short messages are copied by the
+  receive thread into message pages that are released immediately after
+  execution, their variable sized fields are copied into the memory
+  container.
+*/
+struct ic_record_pages
+{
+  IC_SOCK_BUF_PAGE **pages;
+  guint32 num_pages;
+  guint32 max_pages;
+  IC_MEMORY_CONTAINER *copy_mc_ptr;
 };
 
 struct ic_int_where_condition
 {
   IC_WHERE_CONDITION_OPS *cond_ops;
-  guint32 not_used;
+  IC_MEMORY_CONTAINER *mc_ptr;
+  /* Table the condition is defined on, NULL for global conditions */
+  IC_INT_TABLE_DEF *table_def;
+  IC_INT_WHERE_SUBROUTINE *subroutines;
+  guint32 num_subroutines;
+  guint32 max_subroutines;
+  IC_INT_WHERE_MEMORY *memory;
+  guint32 num_memory;
+  guint32 max_memory;
+  /* Set by ic_evaluate_where when the definition is complete */
+  gboolean is_defined;
+  /* Interpreted program and the table it was compiled for */
+  guint32 *program;
+  guint32 num_program_words;
+  IC_INT_TABLE_DEF *program_table_def;
+  /*
+    Set when conjuncts of the top level AND can't be executed in the data
+    node, they're then evaluated in the API on the records received. The
+    program is NULL when no conjunct can be executed in the data node.
+    The memory container is used for the vectors of the evaluation of a
+    batch.
+  */
+  gboolean is_local;
+  guint32 *local_subroutines;
+  guint32 num_local_subroutines;
+  IC_MEMORY_CONTAINER *eval_mc_ptr;
 };
 
 struct ic_int_apid_error
@@ -415,6 +645,47 @@ struct ic_reference_container
   IC_REFERENCE_TYPE ref_type;
 };
 
+/*
+  A scan has one receiver per fragment scanned in parallel. Each receiver
+  tracks the batch currently being received from its fragment, a batch is
+  complete when the NDB_SCANCONF entry for it has arrived together with all
+  its RECORD_INFO messages, these can arrive in any order.
+
+  RECORD_INFO messages of scans use a fragment reference that contains the
+  query reference and the receiver index, the highest bit distinguishes
+  them from key query references.
+*/
+#define IC_SCAN_FRAG_REF_FLAG (1U << 31)
+#define IC_MAX_SCAN_QUERY_REF ((1U << 23) - 1)
+#define IC_GET_SCAN_FRAG_REF(query_ref, frag_index) \
+  (IC_SCAN_FRAG_REF_FLAG | ((guint32)(query_ref) << 8) | (frag_index))
+#define IC_GET_QUERY_REF_FROM_FRAG_REF(frag_ref) \
+  (((frag_ref) & ~IC_SCAN_FRAG_REF_FLAG) >> 8)
+#define IC_GET_FRAG_INDEX_FROM_FRAG_REF(frag_ref) ((frag_ref) & 0xFF)
+
+#define IC_DEFAULT_SCAN_BATCH_SIZE 64
+#define IC_NO_SCAN_FRAGMENT 0xFFFFFFFF
+
+struct ic_int_scan_fragment
+{
+  /* NDB reference to fragment scan, sent in NDB_SCAN_CONTINUE_REQ */
+  guint32 ndb_frag_ref;
+  guint32 num_records_expected;
+  guint32 num_words_expected;
+  guint32 num_records_received;
+  guint32 num_words_received;
+  gboolean conf_received;
+  gboolean is_closed;
+  /*
+    Records of the current batch, kept together with the receive pages
+    they reference until the user has read the batch.
+  */
+  IC_WHERE_ROW_BATCH row_batch;
+  IC_RECORD_PAGES record_pages;
+  /* Range id of each record of the batch in a multi-range scan */
+  guint32 *range_ids;
+};
+
 struct ic_int_apid_query
 {
   /* Public part */
@@ -445,6 +716,7 @@ struct ic_int_apid_query
 
   IC_APID_ERROR *error;
   void *user_reference;
+  IC_APID_CALLBACK_FUNC callback_func;
 
   /* fields used by scans, read key queries and write key queries */
   IC_FIELD_IN_QUERY **fields;
@@ -489,6 +761,72 @@ struct ic_int_apid_query
   */
   gboolean is_all_key_fields_defined;
 
+  /* Our reference to the query, index into op_bindings while executing */
+  guint64 my_query_ref;
+  /* Error code reported by NDB or at send, set together with any_error */
+  int error_code;
+  /*
+    A key query is completed when the NDB_PRIM_KEYCONF has arrived and
+    all the words of read data it reports have arrived in RECORD_INFO
+    messages, these can arrive both before and after NDB_PRIM_KEYCONF.
+  */
+  gboolean conf_received;
+  guint32 num_words_expected;
+  guint32 num_words_received;
+  /*
+    Fields of the record decoded so far, the fields are received in the
+    order they were defined. The receive pages referenced by the record
+    in the buffer values are kept until the next record is received or
+    the query is freed.
+  */
+  guint32 num_fields_received;
+  IC_RECORD_PAGES record_pages;
+
+  /*
+    Scan parallelism and batch size, a parallelism of 0 means that all
+    fragments of the table are scanned in parallel.
+  */
+  guint32 scan_parallelism;
+  guint32 scan_batch_size;
+  /*
+    Receivers of the scan, allocated at first scan and kept until the
+    query is freed. The continue references are the NDB references of
+    the fragments with a batch read by the user that
+    NDB_SCAN_CONTINUE_REQ is to be sent for.
+  */
+  IC_INT_SCAN_FRAGMENT *scan_fragments;
+  guint32 *scan_continue_refs;
+  /*
+    Fragments with a received batch waiting to be read by the user, kept
+    as a circular queue, each fragment is in the queue at most once.
+    The batch currently read is in scan_current_frag.
+  */
+  guint32 *scan_ready_frags;
+  guint32 first_scan_ready_frag;
+  guint32 num_scan_ready_frags;
+  guint32 scan_current_frag;
+  guint32 scan_next_row;
+  /* Record batches of all fragments */
+  gchar *scan_row_buffer;
+  guint8 *scan_rows_selected;
+  guint32 num_scan_fragments_allocated;
+  guint32 num_scan_fragments;
+  guint32 num_open_scan_fragments;
+  guint32 num_scan_continue_refs;
+  /* Range id of the current record in a multi-range scan */
+  guint32 range_id;
+  /* Keep the range condition also after the query completed */
+  gboolean keep_range;
+  /* Keep the where condition also after the query completed */
+  gboolean keep_where;
+  /* Sent by the user, waiting for NDB_CONNECTCONF of its transaction */
+  gboolean send_requested;
+  /* Set when the scan is to be closed after an error */
+  gboolean scan_stop;
+  gboolean in_scan_continue_list;
+  /* Set when all fragments are closed and all records have been read */
+  gboolean scan_completed;
+
   IC_APID_QUERY_LIST_TYPE list_type;
 
   IC_INT_APID_QUERY *next_trans_query;
@@ -509,6 +847,8 @@ struct ic_int_apid_query
   IC_INT_APID_QUERY *next_executed_query;
   IC_INT_APID_QUERY *prev_executed_query;
 
+  IC_INT_APID_QUERY *next_scan_continue;
+
   IC_INT_APID_GLOBAL *apid_global;
 };
 
@@ -533,6 +873,11 @@ struct ic_int_apid_connection
   IC_API_CONFIG_SERVER *apic;
   IC_BITMAP *cluster_id_bitmap;
   IC_THREAD_CONNECTION *thread_conn;
+  /*
+    Pool of send pages used by this connection, this is the pool of the
+    NUMA node the connection was created on when NUMA placement is used.
+  */
+  IC_SOCK_BUF *send_buf_pool;
   IC_SOCK_BUF_PAGE *free_pages;
   IC_INT_METADATA_TRANSACTION *md_trans;
 
@@ -553,7 +898,7 @@ struct ic_int_apid_connection
     clusters. We could have had a global hash table with cluster id
     part of the key, but we opted for this variant instead.
   */
-  IC_HASHTABLE **md_hash;
+  IC_OA_HASHTABLE **md_hash;
   IC_COND *signal;
 
   /**
@@ -568,10 +913,23 @@ struct ic_int_apid_connection
 
   guint32 num_clusters;
   guint32 thread_id;
+  /* Last node used as transaction coordinator, used for round robin */
+  guint32 last_tc_node_id;
+  /* Transaction counter used to create unique transaction ids */
+  guint32 num_transactions;
+  /*
+    Set when a transaction with queries waiting for its transaction record
+    got connected, the queries are sent when all received messages have
+    been executed.
+  */
+  gboolean send_waiting_queries;
   /*
     The queries pass through a set of lists from start to end.
 
-    It starts in the defined list. This list is a normal single linked list.
+    It starts in the defined list. This list is a doubly linked list since
+    queries of transactions still waiting for their transaction record
+    in NDB stay in the list when the other queries are sent. They're
+    sent from the poll that receives the transaction record.
 
     When the user sends the query to the cluster they enter the
     executing list. This list is a doubly linked list since they can leave
@@ -599,6 +957,23 @@ struct ic_int_apid_connection
   IC_INT_APID_QUERY *first_executed_query;
   IC_INT_APID_QUERY *last_executed_query;
 
+  /*
+    Scans with fragments waiting for NDB_SCAN_CONTINUE_REQ, these are sent
+    at the next send or when all received messages have been executed and
+    the callbacks have been called.
+  */
+  IC_INT_APID_QUERY *first_scan_continue;
+  IC_INT_APID_QUERY *last_scan_continue;
+
+  /*
+    Transactions with commit or rollback requested and all queries
+    completed, the commit or abort is sent to NDB or, when the outcome is
+    known, the transaction is released after calling its callback at the
+    end of the poll.
+  */
+  IC_INT_TRANSACTION *first_end_trans;
+  IC_INT_TRANSACTION *last_end_trans;
+
   IC_SEND_CLUSTER_NODE *first_send_cluster_node;
   IC_SEND_CLUSTER_NODE *last_send_cluster_node;
 
@@ -641,6 +1016,57 @@ struct ic_apid_cluster_data
    */
   guint32 cluster_id;
 
+  /**
+    The table cache is an immutable snapshot of all created and valid
+    table definitions in cluster_md_hash. It's read without any lock, a
+    reader announces itself by setting its slot in reader_epoch to the
+    current cache epoch before reading table_cache and clears it when
+    done. Changes are made under the mutex by publishing a new snapshot
+    and stepping the epoch, the old snapshot is placed in the retired
+    list and is freed first when no reader can still be using it.
+  */
+  IC_TABLE_CACHE *table_cache;
+  volatile gint table_cache_epoch;
+  volatile gint reader_epoch[IC_MAX_THREAD_CONNECTIONS];
+  IC_TABLE_CACHE *first_retired_cache;
+  IC_TABLE_CACHE *last_retired_cache;
+};
+
+/**
+  The table cache is an open addressing hash table of table definitions.
+  Each table definition in the cache has a reference to it which is
+  released when the snapshot it was removed from is freed.
+*/
+struct ic_table_cache_entry
+{
+  guint32 hash_value;
+  IC_INT_TABLE_DEF *table_def;
+};
+
+struct ic_table_cache
+{
+  guint32 num_entries;
+  guint32 size;
+  IC_TABLE_CACHE_ENTRY *entries;
+  /* Fields used when the snapshot has been retired */
+  gint retire_epoch;
+  IC_INT_TABLE_DEF *removed_table_def;
+  IC_TABLE_CACHE *next_retired_cache;
+};
+
+/*
+  With NUMA placement each NUMA node has its own pools of send/receive
+  pages and NDB messages. The pools are created by the first receive
+  thread or user thread executing on the node such that the memory is
+  placed on the node. The pools are protected by the apid_global mutex
+  until created, after that they are only read.
+*/
+struct ic_apid_numa_node
+{
+  IC_SOCK_BUF *send_buf_pool;
+  IC_SOCK_BUF *ndb_message_pool;
+  guint32 *cpu_ids;
+  guint32 num_cpus;
 };
 
 #define IC_MAX_SERVER_PORTS_LISTEN 256
@@ -671,6 +1097,30 @@ struct ic_int_apid_global
   gboolean use_external_connect;
   IC_SOCK_BUF *send_buf_pool;
   IC_SOCK_BUF *ndb_message_pool;
+  /*
+    NUMA nodes used for NUMA placement, num_numa_nodes is 0 when NUMA
+    placement isn't used. cpu_numa_node maps a processor id to its
+    NUMA node. next_numa_node is used to spread the receive threads
+    over the NUMA nodes.
+  */
+  IC_APID_NUMA_NODE *numa_nodes;
+  guint32 *cpu_numa_node;
+  guint32 num_numa_nodes;
+  guint32 num_cpus;
+  guint32 next_numa_node;
+  /*
+    CPU placement of threads, receive_cpus has one CPU per dedicated
+    receive core, send_cpus one CPU per dedicated send core and user_cpus
+    all CPUs of the cores not dedicated. num_user_cpus is 0 when no CPU
+    placement is used. All three point into cpu_placement.
+  */
+  guint32 *cpu_placement;
+  guint32 *receive_cpus;
+  guint32 *send_cpus;
+  guint32 *user_cpus;
+  guint32 num_receive_cpus;
+  guint32 num_send_cpus;
+  guint32 num_user_cpus;
   IC_GRID_COMM *grid_comm;
   IC_API_CONFIG_SERVER *apic;
   /**
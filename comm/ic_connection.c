@@ -202,6 +202,17 @@ set_option_size(int sockfd, int size, int old_size,
   return old_size;
 }
 
+/* A nonblocking socket can't read or write more without waiting */
+static gboolean
+is_would_block_error(int error)
+{
+#ifndef WINDOWS
+  return (error == EAGAIN || error == EWOULDBLOCK);
+#else
+  return (error == WSAEWOULDBLOCK);
+#endif
+}
+
 static void
 set_socket_nonblocking(int sockfd, gboolean flag)
 {
@@ -215,7 +226,7 @@ set_socket_nonblocking(int sockfd, gboolean flag)
   int flags, error;
   int nonblocking_flag;
 
-  if ((flags= fcntl(sockfd, F_GETFL) < 0))
+  if ((flags= fcntl(sockfd, F_GETFL)) < 0)
   {
     error= errno;
     DEBUG_PRINT(COMM_LEVEL, ("fcntl F_GETFL error: %d", error));
@@ -234,7 +245,7 @@ set_socket_nonblocking(int sockfd, gboolean flag)
     flags|= nonblocking_flag;
   else
     flags&= ~nonblocking_flag;
-  if ((flags= fcntl(sockfd, F_SETFL, (long)flags) < 0))
+  if (fcntl(sockfd, F_SETFL, (long)flags) < 0)
   {
     error= ic_get_last_socket_error();
     DEBUG_PRINT(COMM_LEVEL, ("fcntl F_SETFL error: %d", error));
@@ -1078,6 +1089,76 @@ struct ic_send_state
 };
 typedef struct ic_send_state IC_SEND_STATE;
 
+static void
+add_sent_buffer_stat(IC_INT_CONNECTION *conn, guint32 buf_size)
+{
+  unsigned i;
+  guint32 num_sent_buf_range;
+  guint64 num_sent_bufs= conn->conn_stat.num_sent_buffers;
+  guint64 num_sent_bytes= conn->conn_stat.num_sent_bytes;
+  long double num_sent_square= conn->conn_stat.num_sent_bytes_square_sum;
+
+  i= ic_count_highest_bit((guint32)(buf_size | 32));
+  i-= 6;
+  num_sent_buf_range= conn->conn_stat.num_sent_buf_range[i];
+  conn->conn_stat.num_sent_buffers= num_sent_bufs + 1;
+  conn->conn_stat.num_sent_bytes= num_sent_bytes + buf_size;
+  conn->conn_stat.num_sent_bytes_square_sum=
+                  num_sent_square + (long double)(buf_size*buf_size);
+  conn->conn_stat.num_sent_buf_range[i]= num_sent_buf_range + 1;
+}
+
+static void
+add_rec_buffer_stat(IC_INT_CONNECTION *conn, guint32 buf_size)
+{
+  unsigned i;
+  guint32 range_limit;
+  guint32 num_rec_buf_range;
+  guint64 num_rec_bufs= conn->conn_stat.num_rec_buffers;
+  guint64 num_rec_bytes= conn->conn_stat.num_rec_bytes;
+  long double num_rec_square= conn->conn_stat.num_rec_bytes_square_sum;
+
+  range_limit= 32;
+  for (i= 0; i < 15; i++)
+  {
+    if (buf_size < range_limit)
+      break;
+    range_limit<<= 1;
+  }
+  num_rec_buf_range= conn->conn_stat.num_rec_buf_range[i];
+  conn->conn_stat.num_rec_buffers= num_rec_bufs + 1;
+  conn->conn_stat.num_rec_bytes= num_rec_bytes + buf_size;
+  conn->conn_stat.num_rec_bytes_square_sum=
+                    num_rec_square + (long double)(buf_size*buf_size);
+  conn->conn_stat.num_rec_buf_range[i]= num_rec_buf_range + 1;
+}
+
+/* Implements ic_add_read_stat */
+static void
+add_read_stat(IC_CONNECTION *ext_conn, guint32 size, int error)
+{
+  IC_INT_CONNECTION *conn= (IC_INT_CONNECTION*)ext_conn;
+
+  if (error)
+    conn->conn_stat.num_rec_errors++;
+  else
+    add_rec_buffer_stat(conn, size);
+}
+
+/* Implements ic_add_write_stat */
+static void
+add_write_stat(IC_CONNECTION *ext_conn, guint32 size, int error)
+{
+  IC_INT_CONNECTION *conn= (IC_INT_CONNECTION*)ext_conn;
+
+  if (error == EINTR)
+    conn->conn_stat.num_send_timeouts++;
+  else if (error)
+    conn->conn_stat.num_send_errors++;
+  else
+    add_sent_buffer_stat(conn, size);
+}
+
 static int
 handle_return_write(IC_INT_CONNECTION *conn, gssize ret_code, 
                     IC_SEND_STATE *send_state)
@@ -1086,21 +1167,8 @@ handle_return_write(IC_INT_CONNECTION *conn, gssize ret_code,
 
   if ((int)send_state->write_size == (int)buf_size)
   {
-    unsigned i;
-    guint32 num_sent_buf_range;
-    guint64 num_sent_bufs= conn->conn_stat.num_sent_buffers;
-    guint64 num_sent_bytes= conn->conn_stat.num_sent_bytes;
-    long double num_sent_square= conn->conn_stat.num_sent_bytes_square_sum;
-
-    i= ic_count_highest_bit((guint32)(buf_size | 32));
-    i-= 6;
-    num_sent_buf_range= conn->conn_stat.num_sent_buf_range[i];
     conn->error_code= 0;
-    conn->conn_stat.num_sent_buffers= num_sent_bufs + 1;
-    conn->conn_stat.num_sent_bytes= num_sent_bytes + buf_size;
-    conn->conn_stat.num_sent_bytes_square_sum=
-                    num_sent_square + (long double)(buf_size*buf_size);
-    conn->conn_stat.num_sent_buf_range[i]= num_sent_buf_range + 1;
+    add_sent_buffer_stat(conn, buf_size);
     if (send_state->loop_count && send_state->time_measure)
       g_timer_destroy(send_state->time_measure);
     return 0;
@@ -1124,16 +1192,23 @@ handle_return_write(IC_INT_CONNECTION *conn, gssize ret_code,
       conn->error_code= 0;
       return error;
     }
-    conn->conn_stat.num_send_errors++;
-    conn->bytes_written_before_interrupt= send_state->write_size;
-    conn->error_code= error;
-    conn->err_str= ic_get_strerror(conn->error_code,
-                                   conn->err_buf,
-                                   (guint32)128);
-    DEBUG_PRINT(COMM_LEVEL, ("write error: %d %s",
-                error, conn->err_str));
-    conn->error_code= error;
-    return error;
+    /*
+      When the socket buffer of a nonblocking socket is full we wait for
+      it in the same manner as after a partial write.
+    */
+    if (!is_would_block_error(error))
+    {
+      conn->conn_stat.num_send_errors++;
+      conn->bytes_written_before_interrupt= send_state->write_size;
+      conn->error_code= error;
+      conn->err_str= ic_get_strerror(conn->error_code,
+                                     conn->err_buf,
+                                     (guint32)128);
+      DEBUG_PRINT(COMM_LEVEL, ("write error: %d %s",
+                  error, conn->err_str));
+      conn->error_code= error;
+      return error;
+    }
   }
   if (send_state->loop_count)
   {
@@ -1398,28 +1473,9 @@ read_socket_connection(IC_CONNECTION *ext_conn,
 #endif
     if (ret_code > 0)
     {
-      unsigned i;
-      int range_limit;
-      guint32 num_rec_buf_range;
-      guint64 num_rec_bufs= conn->conn_stat.num_rec_buffers;
-      guint64 num_rec_bytes= conn->conn_stat.num_rec_bytes;
-      long double num_rec_square= conn->conn_stat.num_rec_bytes_square_sum;
-      
       *read_size= ret_code;
-      range_limit= 32;
-      for (i= 0; i < 15; i++)
-      {
-        if (ret_code < range_limit)
-          break;
-        range_limit<<= 1;
-      }
-      num_rec_buf_range= conn->conn_stat.num_rec_buf_range[i];
       conn->error_code= 0;
-      conn->conn_stat.num_rec_buffers= num_rec_bufs + 1;
-      conn->conn_stat.num_rec_bytes= num_rec_bytes + ret_code;
-      conn->conn_stat.num_rec_bytes_square_sum=
-                        num_rec_square + (long double)(ret_code*ret_code);
-      conn->conn_stat.num_rec_buf_range[i]= num_rec_buf_range + 1;
+      add_rec_buffer_stat(conn, (guint32)ret_code);
       return 0;
     }
     if (ret_code == 0)
@@ -1433,6 +1489,12 @@ read_socket_connection(IC_CONNECTION *ext_conn,
     else
       error= (-1) * ret_code;
   } while (error == EINTR);
+  if (is_would_block_error(error))
+  {
+    /* No data to read on a nonblocking socket, this isn't an error */
+    conn->error_code= 0;
+    return EWOULDBLOCK;
+  }
   conn->conn_stat.num_rec_errors++;
   conn->error_code= ic_get_last_socket_error();
   conn->err_str= ic_get_strerror(conn->error_code,
@@ -1942,6 +2004,8 @@ set_nonblocking_flag(IC_CONNECTION *ext_conn)
   IC_INT_CONNECTION *conn= (IC_INT_CONNECTION*)ext_conn;
 
   conn->is_nonblocking= TRUE;
+  if (conn->rw_sockfd)
+    set_socket_nonblocking(conn->rw_sockfd, TRUE);
 }
 
 static int
@@ -2074,6 +2138,8 @@ int_create_socket_object(gboolean is_client,
   conn->conn_op.ic_write_connection= write_socket_connection;
   conn->conn_op.ic_writev_connection= writev_socket_connection;
   conn->conn_op.ic_flush_connection= flush_connection;
+  conn->conn_op.ic_add_read_stat= add_read_stat;
+  conn->conn_op.ic_add_write_stat= add_write_stat;
   conn->conn_op.ic_get_port_number= get_port_number;
 
   init_connect_stat(conn);
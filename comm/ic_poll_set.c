@@ -33,12 +33,19 @@ free_poll_set(IC_POLL_SET *ext_poll_set)
   IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
   DEBUG_ENTRY("free_poll_set");
 
-  for (i= 0; i < poll_set->num_poll_connections; i++)
-    ic_free(poll_set->poll_connections[i]);
   if (poll_set->poll_connections)
+  {
+    for (i= 0; i < poll_set->num_allocated_connections; i++)
+    {
+      if (poll_set->poll_connections[i])
+        ic_free(poll_set->poll_connections[i]);
+    }
     ic_free(poll_set->poll_connections);
+  }
   if (poll_set->ready_connections)
     ic_free(poll_set->ready_connections);
+  if (poll_set->pending_connections)
+    ic_free(poll_set->pending_connections);
   if (poll_set->need_close_at_free)
     ic_close_socket(poll_set->poll_set_fd);
   if (poll_set->impl_specific_ptr)
@@ -47,19 +54,29 @@ free_poll_set(IC_POLL_SET *ext_poll_set)
   DEBUG_RETURN_EMPTY;
 }
 
-#define MAX_POLL_SET_CONNECTIONS 1024
+/*
+  The poll set starts out small and doubles its size each time it's
+  full, the implementations that use an event array set impl_event_size
+  and have their event array grown together with the connection arrays.
+*/
+#define IC_POLL_SET_INITIAL_CONNECTIONS 64
 static int
 alloc_poll_set(IC_INT_POLL_SET **poll_set)
 {
+  guint32 size= IC_POLL_SET_INITIAL_CONNECTIONS;
   DEBUG_ENTRY("alloc_poll_set");
   if (!(*poll_set= (IC_INT_POLL_SET*)ic_calloc(sizeof(IC_INT_POLL_SET))))
     goto mem_error;
-  (*poll_set)->num_allocated_connections= MAX_POLL_SET_CONNECTIONS;
+  (*poll_set)->num_allocated_connections= size;
+  (*poll_set)->max_connections= IC_MAX_UINT32;
   if (!((*poll_set)->poll_connections= (IC_POLL_CONNECTION**)
-       ic_calloc(sizeof(IC_POLL_CONNECTION*) * MAX_POLL_SET_CONNECTIONS)))
+       ic_calloc(sizeof(IC_POLL_CONNECTION*) * size)))
     goto mem_error;
   if (!((*poll_set)->ready_connections= (IC_POLL_CONNECTION**)
-       ic_calloc(sizeof(IC_POLL_CONNECTION*) * MAX_POLL_SET_CONNECTIONS)))
+       ic_calloc(sizeof(IC_POLL_CONNECTION*) * size)))
+    goto mem_error;
+  if (!((*poll_set)->pending_connections= (IC_POLL_CONNECTION**)
+       ic_calloc(sizeof(IC_POLL_CONNECTION*) * size)))
     goto mem_error;
   DEBUG_RETURN_INT(0);
 mem_error:
@@ -68,17 +85,76 @@ mem_error:
   DEBUG_RETURN_INT(IC_ERROR_MEM_ALLOC);
 }
 
+/* Allocate the event array of an implementation */
+static int
+alloc_poll_set_events(IC_INT_POLL_SET *poll_set, guint32 event_size)
+{
+  if (!(poll_set->impl_specific_ptr=
+        ic_calloc(event_size * poll_set->num_allocated_connections)))
+    return IC_ERROR_MEM_ALLOC;
+  poll_set->impl_event_size= event_size;
+  return 0;
+}
+
+static int
+grow_array(void **array, guint32 entry_size, guint32 old_size,
+           guint32 new_size)
+{
+  void *new_array;
+
+  if (!(new_array= ic_calloc(entry_size * new_size)))
+    return IC_ERROR_MEM_ALLOC;
+  memcpy(new_array, *array, entry_size * old_size);
+  ic_free(*array);
+  *array= new_array;
+  return 0;
+}
+
+/*
+  Double the size of the poll set. Entries keep their index, so the
+  implementations can continue to use the index to find the connection.
+  The ready and pending lists can at most contain all connections, so
+  they're grown to the same size.
+*/
+static int
+grow_poll_set(IC_INT_POLL_SET *poll_set)
+{
+  guint32 old_size= poll_set->num_allocated_connections;
+  guint32 new_size;
+  guint32 conn_size= sizeof(IC_POLL_CONNECTION*);
+  DEBUG_ENTRY("grow_poll_set");
+
+  if (old_size >= poll_set->max_connections)
+    DEBUG_RETURN_INT(IC_ERROR_POLL_SET_FULL);
+  new_size= IC_MIN(2 * old_size, poll_set->max_connections);
+  if (grow_array((void**)&poll_set->poll_connections,
+                 conn_size, old_size, new_size) ||
+      grow_array((void**)&poll_set->ready_connections,
+                 conn_size, old_size, new_size) ||
+      grow_array((void**)&poll_set->pending_connections,
+                 conn_size, old_size, new_size) ||
+      (poll_set->impl_event_size &&
+       grow_array(&poll_set->impl_specific_ptr,
+                  poll_set->impl_event_size, old_size, new_size)))
+    DEBUG_RETURN_INT(IC_ERROR_MEM_ALLOC);
+  DEBUG_PRINT(COMM_LEVEL, ("Poll set grown to %u connections", new_size));
+  poll_set->num_allocated_connections= new_size;
+  DEBUG_RETURN_INT(0);
+}
+
 static int
 add_poll_set_member(IC_INT_POLL_SET *poll_set, int fd, void *user_obj,
                     guint32 *index)
 {
   guint32 i;
-  guint32 loc_index= MAX_POLL_SET_CONNECTIONS;
+  guint32 loc_index= poll_set->num_allocated_connections;
+  int ret_code;
   IC_POLL_CONNECTION *poll_conn;
   DEBUG_ENTRY("add_poll_set_member");
 
-  if (poll_set->num_poll_connections == poll_set->num_allocated_connections)
-    DEBUG_RETURN_INT(IC_ERROR_POLL_SET_FULL);
+  if (poll_set->num_poll_connections == poll_set->num_allocated_connections &&
+      (ret_code= grow_poll_set(poll_set)))
+    DEBUG_RETURN_INT(ret_code);
   if (!(poll_conn= (IC_POLL_CONNECTION*)ic_malloc(sizeof(IC_POLL_CONNECTION))))
     DEBUG_RETURN_INT(IC_ERROR_MEM_ALLOC);
   if (poll_set->use_compact_array)
@@ -97,7 +173,7 @@ add_poll_set_member(IC_INT_POLL_SET *poll_set, int fd, void *user_obj,
       }
     }
   }
-  ic_require(loc_index < MAX_POLL_SET_CONNECTIONS);
+  ic_require(loc_index < poll_set->num_allocated_connections);
   poll_set->poll_connections[loc_index]= poll_conn;
 
   DEBUG_PRINT(COMM_LEVEL, ("Added fd = %d to slot %u for poll layer fd = %d",
@@ -105,41 +181,42 @@ add_poll_set_member(IC_INT_POLL_SET *poll_set, int fd, void *user_obj,
   poll_conn->fd= fd;
   poll_conn->user_obj= user_obj;
   poll_conn->index= loc_index;
+  poll_conn->ret_code= 0;
+  poll_conn->is_ready= FALSE;
   poll_set->num_poll_connections++;
   *index= loc_index;
   DEBUG_RETURN_INT(0);
 }
 
-static int
-remove_poll_set_member(IC_INT_POLL_SET *poll_set, int fd,
-                       guint32 *index_removed)
+/* Remove a connection from the ready list or the pending list */
+static void
+remove_from_list(IC_POLL_CONNECTION **list,
+                 guint32 *num_entries,
+                 IC_POLL_CONNECTION *poll_conn)
 {
-  guint32 i, num_ready_connections;
-  guint32 found_index= MAX_POLL_SET_CONNECTIONS;
-  IC_POLL_CONNECTION *poll_conn;
-  DEBUG_ENTRY("remove_poll_set_member");
+  guint32 i;
 
-  if (poll_set->poll_scan_ongoing)
+  for (i= 0; i < *num_entries; i++)
   {
-    num_ready_connections= poll_set->num_ready_connections;
-    for (i= 0; i < poll_set->num_ready_connections; i++)
+    if (list[i] == poll_conn)
     {
-      poll_conn= poll_set->ready_connections[i];
-      if (poll_conn->fd == fd)
-      {
-        /*
-          The removed connection was in the ready set, however we're
-          removing it from the set and we don't want to report events
-          on a connection no longer covered.
-        */
-        poll_set->ready_connections[i]= 
-          poll_set->ready_connections[num_ready_connections - 1];
-        poll_set->ready_connections[num_ready_connections - 1]= NULL;
-        poll_set->num_ready_connections= num_ready_connections - 1;
-        break;
-      }
+      list[i]= list[*num_entries - 1];
+      list[*num_entries - 1]= NULL;
+      (*num_entries)--;
+      return;
     }
   }
+}
+
+static int
+remove_poll_set_member(IC_INT_POLL_SET *poll_set, int fd,
+                       guint32 *index_removed)
+{
+  guint32 i;
+  guint32 found_index= poll_set->num_allocated_connections;
+  IC_POLL_CONNECTION *poll_conn= NULL;
+  DEBUG_ENTRY("remove_poll_set_member");
+
   for (i= 0; i < poll_set->num_allocated_connections; i++)
   {
     poll_conn= poll_set->poll_connections[i];
@@ -149,8 +226,24 @@ remove_poll_set_member(IC_INT_POLL_SET *poll_set, int fd,
       break;
     }
   }
-  if (found_index == MAX_POLL_SET_CONNECTIONS)
+  if (found_index == poll_set->num_allocated_connections)
     DEBUG_RETURN_INT(IC_ERROR_NOT_FOUND_IN_POLL_SET);
+  if (poll_conn->is_ready)
+  {
+    /*
+      The removed connection was in the ready set, however we're
+      removing it from the set and we don't want to report events
+      on a connection no longer covered.
+    */
+    remove_from_list(poll_set->ready_connections,
+                     &poll_set->num_ready_connections,
+                     poll_conn);
+    remove_from_list(poll_set->pending_connections,
+                     &poll_set->num_pending_connections,
+                     poll_conn);
+  }
+  if (poll_set->current_connection == poll_conn)
+    poll_set->current_connection= NULL;
   ic_free(poll_conn);
   poll_set->num_poll_connections--;
   if (poll_set->use_compact_array)
@@ -167,6 +260,46 @@ remove_poll_set_member(IC_INT_POLL_SET *poll_set, int fd,
   DEBUG_RETURN_INT(0);
 }
 
+/*
+  Start a new check of the poll set. Connections not yet reported from
+  the previous check remain in the ready list and the pending connections
+  are added to it. We return the time to wait in the OS, we shouldn't
+  wait if there are connections to report already.
+*/
+static int
+start_check_poll_set(IC_INT_POLL_SET *poll_set, int ms_time)
+{
+  guint32 i;
+
+  for (i= 0; i < poll_set->num_pending_connections; i++)
+  {
+    poll_set->ready_connections[poll_set->num_ready_connections++]=
+      poll_set->pending_connections[i];
+    poll_set->pending_connections[i]= NULL;
+  }
+  poll_set->num_pending_connections= 0;
+  poll_set->current_connection= NULL;
+  return poll_set->num_ready_connections ? 0 : ms_time;
+}
+
+/* Add a connection reported by the OS to the ready list */
+static void
+add_ready_connection(IC_INT_POLL_SET *poll_set,
+                     IC_POLL_CONNECTION *poll_conn,
+                     int ret_code)
+{
+  if (poll_conn->is_ready)
+  {
+    /* Already in the ready list, only keep any error reported */
+    if (ret_code)
+      poll_conn->ret_code= ret_code;
+    return;
+  }
+  poll_conn->is_ready= TRUE;
+  poll_conn->ret_code= ret_code;
+  poll_set->ready_connections[poll_set->num_ready_connections++]= poll_conn;
+}
+
 static const IC_POLL_CONNECTION*
 get_next_connection(IC_POLL_SET *ext_poll_set)
 {
@@ -179,29 +312,131 @@ get_next_connection(IC_POLL_SET *ext_poll_set)
   if (num_ready_connections == 0)
   {
     poll_set->poll_scan_ongoing= FALSE;
+    poll_set->current_connection= NULL;
     DEBUG_RETURN_PTR(NULL);
   }
   num_ready_connections--;
   poll_conn= poll_set->ready_connections[num_ready_connections];
+  poll_set->ready_connections[num_ready_connections]= NULL;
   poll_set->num_ready_connections= num_ready_connections;
+  poll_conn->is_ready= FALSE;
+  poll_set->current_connection= poll_conn;
   DEBUG_RETURN_PTR(poll_conn);
 }
 
+static void
+poll_set_still_ready(IC_POLL_SET *ext_poll_set)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+  IC_POLL_CONNECTION *poll_conn= poll_set->current_connection;
+
+  if (!poll_conn || poll_conn->is_ready)
+    return;
+  poll_conn->is_ready= TRUE;
+  poll_set->pending_connections[poll_set->num_pending_connections++]=
+    poll_conn;
+}
+
 static gboolean
 is_poll_set_full(IC_POLL_SET *ext_poll_set)
 {
   IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
-  if (poll_set->num_allocated_connections <= poll_set->num_poll_connections)
+  if (poll_set->max_connections <= poll_set->num_poll_connections)
     return TRUE;
   return FALSE;
 }
 
+static gboolean
+no_async_write(IC_POLL_SET *ext_poll_set)
+{
+  (void)ext_poll_set;
+  return FALSE;
+}
+
+static int
+no_async_writev(IC_POLL_SET *ext_poll_set,
+                int fd,
+                IC_IOVEC *write_vector,
+                guint32 iovec_size,
+                void *user_obj)
+{
+  (void)ext_poll_set;
+  (void)fd;
+  (void)write_vector;
+  (void)iovec_size;
+  (void)user_obj;
+  return IC_ERROR_PROGRAM_NOT_SUPPORTED;
+}
+
+static const IC_POLL_WRITE*
+no_next_write(IC_POLL_SET *ext_poll_set)
+{
+  (void)ext_poll_set;
+  return NULL;
+}
+
+static int
+no_register_write_buffers(IC_POLL_SET *ext_poll_set,
+                          IC_IOVEC *buffers,
+                          guint32 num_buffers)
+{
+  (void)ext_poll_set;
+  (void)buffers;
+  (void)num_buffers;
+  return IC_ERROR_PROGRAM_NOT_SUPPORTED;
+}
+
+static int
+no_cancel_write(IC_POLL_SET *ext_poll_set, void *user_obj)
+{
+  (void)ext_poll_set;
+  (void)user_obj;
+  return IC_ERROR_PROGRAM_NOT_SUPPORTED;
+}
+
+static gboolean
+no_async_read(IC_POLL_SET *ext_poll_set)
+{
+  (void)ext_poll_set;
+  return FALSE;
+}
+
+static int
+no_provide_read_buffer(IC_POLL_SET *ext_poll_set,
+                       gchar *buf,
+                       guint32 buf_size,
+                       guint32 buf_id)
+{
+  (void)ext_poll_set;
+  (void)buf;
+  (void)buf_size;
+  (void)buf_id;
+  return IC_ERROR_PROGRAM_NOT_SUPPORTED;
+}
+
+static const IC_POLL_READ*
+no_next_read(IC_POLL_SET *ext_poll_set)
+{
+  (void)ext_poll_set;
+  return NULL;
+}
+
 static void
 set_common_methods(IC_INT_POLL_SET *poll_set)
 {
   poll_set->poll_ops.ic_get_next_connection= get_next_connection;
+  poll_set->poll_ops.ic_poll_set_still_ready= poll_set_still_ready;
   poll_set->poll_ops.ic_free_poll_set= free_poll_set;
   poll_set->poll_ops.ic_is_poll_set_full= is_poll_set_full;
+  poll_set->poll_ops.ic_poll_set_has_async_write= no_async_write;
+  poll_set->poll_ops.ic_poll_set_async_writev= no_async_writev;
+  poll_set->poll_ops.ic_get_next_write= no_next_write;
+  poll_set->poll_ops.ic_poll_set_register_write_buffers=
+    no_register_write_buffers;
+  poll_set->poll_ops.ic_poll_set_cancel_write= no_cancel_write;
+  poll_set->poll_ops.ic_poll_set_has_async_read= no_async_read;
+  poll_set->poll_ops.ic_poll_set_provide_read_buffer= no_provide_read_buffer;
+  poll_set->poll_ops.ic_get_next_read= no_next_read;
 }
 
 #ifdef HAVE_EPOLL_CREATE
@@ -219,8 +454,12 @@ epoll_poll_set_add_connection(IC_POLL_SET *ext_poll_set, int fd,
   if ((ret_code= add_poll_set_member(poll_set, fd, user_obj, &index)))
     goto end;
 
+  /*
+    Edge-triggered, a socket isn't reported again until new data arrives,
+    see ic_poll_set_still_ready for sockets not drained by the user.
+  */
   ic_zero(&add_event, sizeof(struct epoll_event));
-  add_event.events= EPOLLIN;
+  add_event.events= EPOLLIN | EPOLLET;
   add_event.data.fd= fd;
   add_event.data.u32= index;
   if ((ret_code= epoll_ctl(poll_set->poll_set_fd,
@@ -250,7 +489,7 @@ epoll_poll_set_remove_connection(IC_POLL_SET *ext_poll_set, int fd)
     error codes properly.
   */
   ic_zero(&delete_event, sizeof(struct epoll_event));
-  delete_event.events= EPOLLIN;
+  delete_event.events= EPOLLIN | EPOLLET;
   delete_event.data.u32= index;
   delete_event.data.fd= fd;
   if ((ret_code= epoll_ctl(poll_set->poll_set_fd,
@@ -290,6 +529,7 @@ epoll_check_poll_set(IC_POLL_SET *ext_poll_set, int ms_time)
   IC_POLL_CONNECTION *poll_conn;
   DEBUG_ENTRY("epoll_check_poll_set");
 
+  ms_time= start_check_poll_set(poll_set, ms_time);
   if ((ret_code= epoll_wait(poll_set->poll_set_fd,
                             rec_event,
                             (int)poll_set->num_allocated_connections,
@@ -319,22 +559,20 @@ epoll_check_poll_set(IC_POLL_SET *ext_poll_set, int ms_time)
   {
     index= (guint32)rec_event[i].data.u32;
     poll_conn= poll_set->poll_connections[index];
-    poll_set->ready_connections[i]= poll_conn;
-    poll_conn->ret_code= 0;
+    add_ready_connection(poll_set, poll_conn, 0);
   }
-  poll_set->num_ready_connections= (guint32)ret_code;
   poll_set->poll_scan_ongoing= TRUE;
-end:
   DEBUG_RETURN_INT(0);
 }
 
-IC_POLL_SET* ic_create_poll_set()
+static IC_POLL_SET*
+epoll_create_poll_set()
 {
   IC_INT_POLL_SET *poll_set= NULL;
   int epoll_fd;
-  DEBUG_ENTRY("ic_create_poll_set(epoll)");
+  DEBUG_ENTRY("epoll_create_poll_set");
 
-  if ((epoll_fd= epoll_create(MAX_POLL_SET_CONNECTIONS)) < 0)
+  if ((epoll_fd= epoll_create(IC_POLL_SET_INITIAL_CONNECTIONS)) < 0)
   {
     ic_printf("Failed to allocate an epoll fd");
     goto end;
@@ -344,8 +582,7 @@ IC_POLL_SET* ic_create_poll_set()
     ic_close_socket(epoll_fd);
     goto end;
   }
-  if (!(poll_set->impl_specific_ptr= ic_calloc(
-        sizeof(struct epoll_event) * MAX_POLL_SET_CONNECTIONS)))
+  if (alloc_poll_set_events(poll_set, sizeof(struct epoll_event)))
   {
     free_poll_set((IC_POLL_SET*)poll_set);
     ic_close_socket(epoll_fd);
@@ -365,6 +602,950 @@ IC_POLL_SET* ic_create_poll_set()
 end:
   DEBUG_RETURN_PTR((IC_POLL_SET*)poll_set);
 }
+
+#ifdef HAVE_IO_URING
+/*
+  The io_uring implementation arms a one-shot poll request for each socket
+  in the poll set. ic_check_poll_set submits the poll requests of the
+  sockets reported in the previous call and waits for new completions in
+  one system call, thus also a busy poll set requires only one system call
+  per check. A socket reported as ready isn't rearmed until the next check
+  since the user is expected to read from it in between. This gives the
+  same level-triggered semantics as the other implementations.
+
+  We use the system calls directly to avoid a dependency on liburing.
+  The kernel must support IORING_FEAT_EXT_ARG to wait with a timeout,
+  if not or if io_uring is disabled we fall back to epoll.
+
+  Each poll request carries the slot index and a generation number of the
+  slot, completions of requests for removed sockets are thus ignored even
+  if the slot has been reused.
+
+  The io_uring implementation also supports asynchronous writes. Each write
+  uses a write slot which holds the message header and a copy of the write
+  vector until the write completes. The user data of a write is the write
+  slot index above the range of poll slot indexes. Writes are submitted
+  immediately, the kernel will mostly complete them already in the submit
+  call when there is room in the socket buffer. Completions are reaped by
+  ic_check_poll_set together with the poll completions.
+
+  When the user has registered the areas that writes are made from, a
+  write of a single buffer within those areas is made as a send from a
+  fixed buffer write, which saves the kernel from mapping the pages on
+  each write. Writes of several buffers always use one sendmsg, a chain
+  of fixed buffer writes would turn one batched send into one socket send
+  per buffer. Fixed buffer writes can't pass MSG_NOSIGNAL and the poll set
+  never changes the signal handling of the process, so registration is
+  refused unless the application already ignores SIGPIPE.
+
+  When the user provides read buffers the poll set switches to reading
+  by itself. Instead of a poll request each socket then has a receive
+  request armed which lets the kernel pick one of the provided buffers
+  when data arrives, ic_check_poll_set thus harvests the data of many
+  sockets in one system call. A socket is rearmed in the next check after
+  a completed read. A socket that found no buffer is rearmed when the
+  next buffer is provided. Removing a socket cancels its receive request
+  and waits for its completion such that data already read isn't lost.
+  Provided buffers and buffer selection were added to the kernel before
+  IORING_FEAT_EXT_ARG so they're always supported when we get here.
+*/
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <signal.h>
+
+#define IC_URING_MAX_CONNECTIONS 1024
+#define IC_URING_ENTRIES IC_URING_MAX_CONNECTIONS
+#define IC_URING_IGNORE_USER_DATA G_MAXUINT64
+#define IC_URING_MAX_WRITES 256
+#define IC_URING_MAX_READ_BUFFERS 1024
+#define IC_URING_MAX_READS (2 * IC_URING_MAX_CONNECTIONS)
+#define IC_URING_READ_BUF_GROUP 0
+#define IC_URING_MAX_FIXED_BUFFERS 64
+#define IC_URING_MAX_FIXED_BUFFER_SIZE (1024 * 1024 * 1024)
+
+struct ic_uring_write
+{
+  struct msghdr msg;
+  struct iovec write_vector[IC_MAX_SEND_BUFFERS];
+  gboolean ongoing;
+  IC_POLL_WRITE poll_write;
+};
+typedef struct ic_uring_write IC_URING_WRITE;
+
+struct ic_uring_state
+{
+  int ring_fd;
+  guint32 sq_entries;
+  guint32 num_unsubmitted;
+  guint32 num_rearm;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sq_ring_ptr;
+  size_t sq_ring_size;
+  void *cq_ring_ptr;
+  size_t cq_ring_size;
+  size_t sqes_size;
+  guint32 generation[IC_URING_MAX_CONNECTIONS];
+  guint32 rearm_index[IC_URING_MAX_CONNECTIONS];
+  guint32 num_free_writes;
+  guint32 num_ready_writes;
+  guint32 free_write_index[IC_URING_MAX_WRITES];
+  guint32 ready_write_index[IC_URING_MAX_WRITES];
+  IC_URING_WRITE writes[IC_URING_MAX_WRITES];
+  guint32 num_fixed_buffers;
+  struct iovec fixed_buffers[IC_URING_MAX_FIXED_BUFFERS];
+  gboolean read_mode;
+  guint32 read_buf_size;
+  guint32 num_kernel_buffers;
+  guint32 num_wait_buffer;
+  guint32 num_ready_reads;
+  guint32 next_ready_read;
+  gchar *read_buf_ptr[IC_URING_MAX_READ_BUFFERS];
+  gboolean read_armed[IC_URING_MAX_CONNECTIONS];
+  guint32 wait_buffer_index[IC_URING_MAX_CONNECTIONS];
+  IC_POLL_READ ready_reads[IC_URING_MAX_READS];
+};
+typedef struct ic_uring_state IC_URING_STATE;
+
+static int uring_cancel_read(IC_INT_POLL_SET *poll_set,
+                             IC_URING_STATE *uring,
+                             int fd);
+
+static int
+uring_enter(IC_URING_STATE *uring,
+            guint32 to_submit,
+            guint32 min_complete,
+            int ms_time)
+{
+  struct io_uring_getevents_arg arg;
+  struct __kernel_timespec ts;
+  unsigned flags= IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+  int ret_code;
+
+  ic_zero(&arg, sizeof(arg));
+  if (min_complete && ms_time >= 0)
+  {
+    ts.tv_sec= ms_time / 1000;
+    ts.tv_nsec= (ms_time % 1000) * 1000000;
+    arg.ts= (guint64)(size_t)&ts;
+  }
+  ret_code= (int)syscall(__NR_io_uring_enter,
+                         uring->ring_fd,
+                         to_submit,
+                         min_complete,
+                         flags,
+                         &arg,
+                         sizeof(arg));
+  if (ret_code < 0)
+  {
+    ret_code= ic_get_last_error();
+    if (ret_code == ETIME || ret_code == EINTR)
+      return 0;
+    return ret_code;
+  }
+  ic_assert((guint32)ret_code == to_submit);
+  return 0;
+}
+
+static int
+uring_submit(IC_URING_STATE *uring)
+{
+  guint32 to_submit= uring->num_unsubmitted;
+  int ret_code;
+
+  if (!to_submit)
+    return 0;
+  if ((ret_code= uring_enter(uring, to_submit, 0, 0)))
+    return ret_code;
+  uring->num_unsubmitted= 0;
+  return 0;
+}
+
+static struct io_uring_sqe*
+uring_get_sqe(IC_URING_STATE *uring)
+{
+  unsigned tail, head, index;
+  struct io_uring_sqe *sqe;
+
+  head= (unsigned)g_atomic_int_get((gint*)uring->sq_head);
+  tail= *uring->sq_tail;
+  if ((tail - head) >= uring->sq_entries)
+  {
+    /* Submission queue is full, submit before we proceed */
+    if (uring_submit(uring))
+      return NULL;
+  }
+  index= tail & *uring->sq_mask;
+  sqe= &uring->sqes[index];
+  ic_zero(sqe, sizeof(struct io_uring_sqe));
+  uring->sq_array[index]= index;
+  return sqe;
+}
+
+static void
+uring_put_sqe(IC_URING_STATE *uring)
+{
+  /* Release the SQE to the kernel, it's submitted at next enter call */
+  g_atomic_int_set((gint*)uring->sq_tail, (gint)(*uring->sq_tail + 1));
+  uring->num_unsubmitted++;
+}
+
+static guint64
+uring_user_data(IC_URING_STATE *uring, guint32 index)
+{
+  return (((guint64)uring->generation[index]) << 32) + index;
+}
+
+static int
+uring_arm_connection(IC_URING_STATE *uring, int fd, guint32 index)
+{
+  struct io_uring_sqe *sqe;
+
+  if (!(sqe= uring_get_sqe(uring)))
+    return IC_ERROR_POLL_SET_FULL;
+  if (uring->read_mode)
+  {
+    sqe->opcode= IORING_OP_RECV;
+    sqe->flags= IOSQE_BUFFER_SELECT;
+    sqe->buf_group= IC_URING_READ_BUF_GROUP;
+    sqe->len= uring->read_buf_size;
+    uring->read_armed[index]= TRUE;
+  }
+  else
+  {
+    sqe->opcode= IORING_OP_POLL_ADD;
+    sqe->poll32_events= POLLIN;
+  }
+  sqe->fd= fd;
+  sqe->user_data= uring_user_data(uring, index);
+  uring_put_sqe(uring);
+  return 0;
+}
+
+static int
+uring_poll_set_add_connection(IC_POLL_SET *ext_poll_set, int fd,
+                              void *user_obj)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+  IC_URING_STATE *uring= (IC_URING_STATE*)poll_set->impl_specific_ptr;
+  int ret_code;
+  guint32 index= 0;
+  DEBUG_ENTRY("uring_poll_set_add_connection");
+
+  if ((ret_code= add_poll_set_member(poll_set, fd, user_obj, &index)))
+    goto end;
+  if ((ret_code= uring_arm_connection(uring, fd, index)))
+  {
+    remove_poll_set_member(poll_set, fd, &index);
+    goto end;
+  }
+end:
+  DEBUG_RETURN_INT(ret_code);
+}
+
+static int
+uring_poll_set_remove_connection(IC_POLL_SET *ext_poll_set, int fd)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+  IC_URING_STATE *uring= (IC_URING_STATE*)poll_set->impl_specific_ptr;
+  int ret_code;
+  guint32 index, i;
+  guint64 user_data;
+  struct io_uring_sqe *sqe;
+  DEBUG_ENTRY("uring_poll_set_remove_connection");
+
+  if (uring->read_mode &&
+      (ret_code= uring_cancel_read(poll_set, uring, fd)))
+    goto end;
+  if ((ret_code= remove_poll_set_member(poll_set, fd, &index)))
+    goto end;
+  if (uring->read_mode)
+  {
+    /* The receive request has completed, ignore anything left behind */
+    uring->generation[index]++;
+    goto end;
+  }
+  for (i= 0; i < uring->num_rearm; i++)
+  {
+    if (uring->rearm_index[i] == index)
+    {
+      /* Poll request isn't armed, simply drop it from rearm list */
+      uring->rearm_index[i]= uring->rearm_index[--uring->num_rearm];
+      uring->generation[index]++;
+      goto end;
+    }
+  }
+  /*
+    Cancel the armed poll request and ensure it's submitted immediately
+    such that the kernel releases its reference to the socket. Bumping the
+    generation ensures that we ignore its completion.
+  */
+  user_data= uring_user_data(uring, index);
+  uring->generation[index]++;
+  if (!(sqe= uring_get_sqe(uring)))
+  {
+    ret_code= IC_ERROR_POLL_SET_FULL;
+    goto end;
+  }
+  sqe->opcode= IORING_OP_POLL_REMOVE;
+  sqe->fd= -1;
+  sqe->addr= user_data;
+  sqe->user_data= IC_URING_IGNORE_USER_DATA;
+  uring_put_sqe(uring);
+  ret_code= uring_submit(uring);
+end:
+  DEBUG_RETURN_INT(ret_code);
+}
+
+/*
+  Returns the index of the registered buffer containing the buffer,
+  IC_URING_MAX_FIXED_BUFFERS if none does.
+*/
+static guint32
+uring_find_fixed_buffer(IC_URING_STATE *uring, IC_IOVEC *buffer)
+{
+  guint32 i;
+  gchar *start, *buf_start= (gchar*)buffer->iov_base;
+
+  for (i= 0; i < uring->num_fixed_buffers; i++)
+  {
+    start= (gchar*)uring->fixed_buffers[i].iov_base;
+    if (buf_start >= start &&
+        buf_start + buffer->iov_len <=
+          start + uring->fixed_buffers[i].iov_len)
+      return i;
+  }
+  return IC_URING_MAX_FIXED_BUFFERS;
+}
+
+static gboolean
+uring_poll_set_has_async_write(IC_POLL_SET *ext_poll_set)
+{
+  (void)ext_poll_set;
+  return TRUE;
+}
+
+static int
+uring_poll_set_async_writev(IC_POLL_SET *ext_poll_set,
+                            int fd,
+                            IC_IOVEC *write_vector,
+                            guint32 iovec_size,
+                            void *user_obj)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+  IC_URING_STATE *uring= (IC_URING_STATE*)poll_set->impl_specific_ptr;
+  IC_URING_WRITE *write;
+  struct io_uring_sqe *sqe;
+  guint32 i, write_index, buf_index;
+  int ret_code;
+  DEBUG_ENTRY("uring_poll_set_async_writev");
+
+  ic_assert(iovec_size > 0 && iovec_size <= IC_MAX_SEND_BUFFERS);
+  buf_index= IC_URING_MAX_FIXED_BUFFERS;
+  if (iovec_size == 1 && uring->num_fixed_buffers)
+    buf_index= uring_find_fixed_buffer(uring, &write_vector[0]);
+  if (uring->num_free_writes == 0 ||
+      !(sqe= uring_get_sqe(uring)))
+    DEBUG_RETURN_INT(IC_ERROR_POLL_SET_FULL);
+  write_index= uring->free_write_index[--uring->num_free_writes];
+  write= &uring->writes[write_index];
+  for (i= 0; i < iovec_size; i++)
+  {
+    write->write_vector[i].iov_base= write_vector[i].iov_base;
+    write->write_vector[i].iov_len= write_vector[i].iov_len;
+  }
+  write->ongoing= TRUE;
+  write->poll_write.user_obj= user_obj;
+  write->poll_write.bytes_written= 0;
+  write->poll_write.ret_code= 0;
+
+  sqe->fd= fd;
+  sqe->user_data= (guint64)(IC_URING_MAX_CONNECTIONS + write_index);
+  if (buf_index != IC_URING_MAX_FIXED_BUFFERS)
+  {
+    sqe->opcode= IORING_OP_WRITE_FIXED;
+    sqe->addr= (guint64)(size_t)write_vector[0].iov_base;
+    sqe->len= (guint32)write_vector[0].iov_len;
+    sqe->buf_index= (guint16)buf_index;
+  }
+  else
+  {
+    ic_zero(&write->msg, sizeof(struct msghdr));
+    write->msg.msg_iov= write->write_vector;
+    write->msg.msg_iovlen= iovec_size;
+    sqe->opcode= IORING_OP_SENDMSG;
+    sqe->addr= (guint64)(size_t)&write->msg;
+    sqe->len= 1;
+    sqe->msg_flags= MSG_NOSIGNAL;
+  }
+  uring_put_sqe(uring);
+  if ((ret_code= uring_submit(uring)))
+  {
+    /*
+      The SQE stays in the submission queue and will be submitted at the
+      next enter call, the write will thus still complete.
+    */
+    DEBUG_PRINT(COMM_LEVEL, ("Failed to submit write, error %d", ret_code));
+  }
+  DEBUG_RETURN_INT(0);
+}
+
+static const IC_POLL_WRITE*
+uring_get_next_write(IC_POLL_SET *ext_poll_set)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+  IC_URING_STATE *uring= (IC_URING_STATE*)poll_set->impl_specific_ptr;
+  guint32 write_index;
+
+  if (uring->num_ready_writes == 0)
+    return NULL;
+  write_index= uring->ready_write_index[--uring->num_ready_writes];
+  uring->free_write_index[uring->num_free_writes++]= write_index;
+  return &uring->writes[write_index].poll_write;
+}
+
+static void
+uring_write_completed(IC_URING_STATE *uring,
+                      guint32 write_index,
+                      int res)
+{
+  IC_URING_WRITE *write= &uring->writes[write_index];
+
+  if (res < 0)
+    write->poll_write.ret_code= -res;
+  else
+    write->poll_write.bytes_written= (guint32)res;
+  write->ongoing= FALSE;
+  uring->ready_write_index[uring->num_ready_writes++]= write_index;
+}
+
+/*
+  A fixed buffer write on a socket closed by the other end raises SIGPIPE,
+  we only use them when the application ignores SIGPIPE.
+*/
+static gboolean
+uring_is_sigpipe_ignored()
+{
+  struct sigaction action;
+
+  if (sigaction(SIGPIPE, NULL, &action))
+    return FALSE;
+  return action.sa_handler == SIG_IGN;
+}
+
+static int
+uring_poll_set_register_write_buffers(IC_POLL_SET *ext_poll_set,
+                                      IC_IOVEC *buffers,
+                                      guint32 num_buffers)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+  IC_URING_STATE *uring= (IC_URING_STATE*)poll_set->impl_specific_ptr;
+  struct iovec fixed_buffers[IC_URING_MAX_FIXED_BUFFERS];
+  guint32 i, num_fixed= 0;
+  gchar *start;
+  size_t size, piece_size;
+  int ret_code;
+  DEBUG_ENTRY("uring_poll_set_register_write_buffers");
+
+  if (!uring_is_sigpipe_ignored())
+    DEBUG_RETURN_INT(IC_ERROR_PROGRAM_NOT_SUPPORTED);
+  /* The kernel limits the size of each registered buffer */
+  for (i= 0; i < num_buffers; i++)
+  {
+    start= (gchar*)buffers[i].iov_base;
+    size= buffers[i].iov_len;
+    while (size && num_fixed < IC_URING_MAX_FIXED_BUFFERS)
+    {
+      piece_size= IC_MIN(size, (size_t)IC_URING_MAX_FIXED_BUFFER_SIZE);
+      fixed_buffers[num_fixed].iov_base= start;
+      fixed_buffers[num_fixed].iov_len= piece_size;
+      num_fixed++;
+      start+= piece_size;
+      size-= piece_size;
+    }
+  }
+  if (num_fixed == 0)
+    DEBUG_RETURN_INT(0);
+  if (syscall(__NR_io_uring_register,
+              uring->ring_fd,
+              IORING_REGISTER_BUFFERS,
+              fixed_buffers,
+              num_fixed) < 0)
+  {
+    /* Commonly the limit on locked memory, writes still work */
+    ret_code= ic_get_last_error();
+    DEBUG_PRINT(COMM_LEVEL, ("Failed to register write buffers, error %d",
+                ret_code));
+    DEBUG_RETURN_INT(ret_code);
+  }
+  memcpy(uring->fixed_buffers, fixed_buffers,
+         num_fixed * sizeof(struct iovec));
+  uring->num_fixed_buffers= num_fixed;
+  DEBUG_RETURN_INT(0);
+}
+
+static int
+uring_poll_set_cancel_write(IC_POLL_SET *ext_poll_set, void *user_obj)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+  IC_URING_STATE *uring= (IC_URING_STATE*)poll_set->impl_specific_ptr;
+  IC_URING_WRITE *write;
+  struct io_uring_sqe *sqe;
+  guint32 i;
+
+  for (i= 0; i < IC_URING_MAX_WRITES; i++)
+  {
+    write= &uring->writes[i];
+    if (!write->ongoing || write->poll_write.user_obj != user_obj)
+      continue;
+    if (!(sqe= uring_get_sqe(uring)))
+      return IC_ERROR_POLL_SET_FULL;
+    sqe->opcode= IORING_OP_ASYNC_CANCEL;
+    sqe->fd= -1;
+    sqe->addr= (guint64)(IC_URING_MAX_CONNECTIONS + i);
+    sqe->user_data= IC_URING_IGNORE_USER_DATA;
+    uring_put_sqe(uring);
+  }
+  return uring_submit(uring);
+}
+
+static int
+uring_provide_buffer(IC_URING_STATE *uring, gchar *buf, guint32 buf_id)
+{
+  struct io_uring_sqe *sqe;
+
+  if (!(sqe= uring_get_sqe(uring)))
+    return IC_ERROR_POLL_SET_FULL;
+  sqe->opcode= IORING_OP_PROVIDE_BUFFERS;
+  sqe->fd= 1; /* Number of buffers */
+  sqe->addr= (guint64)(size_t)buf;
+  sqe->len= uring->read_buf_size;
+  sqe->off= buf_id;
+  sqe->buf_group= IC_URING_READ_BUF_GROUP;
+  sqe->user_data= IC_URING_IGNORE_USER_DATA;
+  uring_put_sqe(uring);
+  uring->read_buf_ptr[buf_id]= buf;
+  uring->num_kernel_buffers++;
+  return 0;
+}
+
+static gboolean
+uring_poll_set_has_async_read(IC_POLL_SET *ext_poll_set)
+{
+  (void)ext_poll_set;
+  return TRUE;
+}
+
+static int
+uring_poll_set_provide_read_buffer(IC_POLL_SET *ext_poll_set,
+                                   gchar *buf,
+                                   guint32 buf_size,
+                                   guint32 buf_id)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+  IC_URING_STATE *uring= (IC_URING_STATE*)poll_set->impl_specific_ptr;
+  guint32 i;
+  int ret_code;
+  DEBUG_ENTRY("uring_poll_set_provide_read_buffer");
+
+  if (buf_id >= IC_URING_MAX_READ_BUFFERS ||
+      buf_size == 0 ||
+      (uring->read_mode && buf_size != uring->read_buf_size) ||
+      (!uring->read_mode && poll_set->num_poll_connections))
+    DEBUG_RETURN_INT(IC_ERROR_PROGRAM_NOT_SUPPORTED);
+  uring->read_mode= TRUE;
+  uring->read_buf_size= buf_size;
+  if ((ret_code= uring_provide_buffer(uring, buf, buf_id)))
+    DEBUG_RETURN_INT(ret_code);
+  /* Sockets that found no buffer are rearmed in the next check */
+  for (i= 0; i < uring->num_wait_buffer; i++)
+    uring->rearm_index[uring->num_rearm++]= uring->wait_buffer_index[i];
+  uring->num_wait_buffer= 0;
+  DEBUG_RETURN_INT(0);
+}
+
+static const IC_POLL_READ*
+uring_get_next_read(IC_POLL_SET *ext_poll_set)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+  IC_URING_STATE *uring= (IC_URING_STATE*)poll_set->impl_specific_ptr;
+
+  if (uring->next_ready_read == uring->num_ready_reads)
+  {
+    uring->next_ready_read= 0;
+    uring->num_ready_reads= 0;
+    return NULL;
+  }
+  return &uring->ready_reads[uring->next_ready_read++];
+}
+
+static void
+uring_read_completed(IC_URING_STATE *uring,
+                     IC_POLL_CONNECTION *poll_conn,
+                     guint32 index,
+                     struct io_uring_cqe *cqe)
+{
+  IC_POLL_READ *poll_read;
+
+  uring->read_armed[index]= FALSE;
+  if (cqe->res == -ECANCELED)
+    return; /* Cancelled by remove connection */
+  if (cqe->res == -ENOBUFS)
+  {
+    /* Wait for a buffer unless one was provided after the request failed */
+    if (uring->num_kernel_buffers)
+      uring->rearm_index[uring->num_rearm++]= index;
+    else
+      uring->wait_buffer_index[uring->num_wait_buffer++]= index;
+    return;
+  }
+  ic_assert(uring->num_ready_reads < IC_URING_MAX_READS);
+  poll_read= &uring->ready_reads[uring->num_ready_reads++];
+  poll_read->user_obj= poll_conn->user_obj;
+  poll_read->buf_id= 0;
+  poll_read->bytes_read= 0;
+  poll_read->ret_code= 0;
+  if (cqe->res > 0)
+  {
+    ic_assert(cqe->flags & IORING_CQE_F_BUFFER);
+    poll_read->buf_id= cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    poll_read->bytes_read= (guint32)cqe->res;
+    uring->rearm_index[uring->num_rearm++]= index;
+  }
+  else if (cqe->res == 0)
+    poll_read->ret_code= IC_END_OF_FILE;
+  else
+    poll_read->ret_code= -cqe->res;
+}
+
+/*
+  Go through all the completed requests and set up the internal data
+  structures such that we can handle get_next_connection, get_next_read
+  and get_next_write calls properly.
+*/
+static void
+uring_reap_completions(IC_INT_POLL_SET *poll_set, IC_URING_STATE *uring)
+{
+  guint32 index, buf_id;
+  unsigned head, tail;
+  struct io_uring_cqe *cqe;
+  IC_POLL_CONNECTION *poll_conn;
+
+  head= *uring->cq_head;
+  tail= (unsigned)g_atomic_int_get((gint*)uring->cq_tail);
+  for (; head != tail; head++)
+  {
+    cqe= &uring->cqes[head & *uring->cq_mask];
+    if (cqe->flags & IORING_CQE_F_BUFFER)
+      uring->num_kernel_buffers--;
+    if (cqe->user_data == IC_URING_IGNORE_USER_DATA)
+      continue;
+    index= (guint32)(cqe->user_data & 0xFFFFFFFF);
+    if (index >= IC_URING_MAX_CONNECTIONS &&
+        index < IC_URING_MAX_CONNECTIONS + IC_URING_MAX_WRITES)
+    {
+      uring_write_completed(uring, index - IC_URING_MAX_CONNECTIONS,
+                            cqe->res);
+      continue;
+    }
+    if (index >= IC_URING_MAX_CONNECTIONS ||
+        uring->generation[index] != (guint32)(cqe->user_data >> 32) ||
+        !(poll_conn= poll_set->poll_connections[index]))
+    {
+      if (cqe->flags & IORING_CQE_F_BUFFER)
+      {
+        /* Read on a removed socket, the buffer is still ours to use */
+        buf_id= cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        uring_provide_buffer(uring, uring->read_buf_ptr[buf_id], buf_id);
+      }
+      continue;
+    }
+    if (uring->read_mode)
+    {
+      uring_read_completed(uring, poll_conn, index, cqe);
+      continue;
+    }
+    add_ready_connection(poll_set, poll_conn, cqe->res < 0 ? -cqe->res : 0);
+    uring->rearm_index[uring->num_rearm++]= index;
+  }
+  g_atomic_int_set((gint*)uring->cq_head, (gint)head);
+}
+
+/*
+  Cancel the receive request of a socket and wait until it has completed,
+  any data read before the cancel is reported through get_next_read. The
+  socket is also dropped from the lists of sockets to arm.
+*/
+static int
+uring_cancel_read(IC_INT_POLL_SET *poll_set,
+                  IC_URING_STATE *uring,
+                  int fd)
+{
+  IC_POLL_CONNECTION *poll_conn;
+  struct io_uring_sqe *sqe;
+  guint32 index, i;
+  int ret_code;
+
+  for (index= 0; index < poll_set->num_allocated_connections; index++)
+  {
+    poll_conn= poll_set->poll_connections[index];
+    if (poll_conn && poll_conn->fd == fd)
+      break;
+  }
+  if (index == poll_set->num_allocated_connections)
+    return 0; /* Reported by remove_poll_set_member */
+  if (uring->read_armed[index])
+  {
+    if (!(sqe= uring_get_sqe(uring)))
+      return IC_ERROR_POLL_SET_FULL;
+    sqe->opcode= IORING_OP_ASYNC_CANCEL;
+    sqe->fd= -1;
+    sqe->addr= uring_user_data(uring, index);
+    sqe->user_data= IC_URING_IGNORE_USER_DATA;
+    uring_put_sqe(uring);
+    while (uring->read_armed[index])
+    {
+      if ((ret_code= uring_enter(uring, uring->num_unsubmitted, 1, -1)))
+        return ret_code;
+      uring->num_unsubmitted= 0;
+      uring_reap_completions(poll_set, uring);
+    }
+  }
+  for (i= 0; i < uring->num_rearm; i++)
+  {
+    if (uring->rearm_index[i] == index)
+    {
+      uring->rearm_index[i]= uring->rearm_index[--uring->num_rearm];
+      break;
+    }
+  }
+  for (i= 0; i < uring->num_wait_buffer; i++)
+  {
+    if (uring->wait_buffer_index[i] == index)
+    {
+      uring->wait_buffer_index[i]=
+        uring->wait_buffer_index[--uring->num_wait_buffer];
+      break;
+    }
+  }
+  return 0;
+}
+
+static int
+uring_check_poll_set(IC_POLL_SET *ext_poll_set, int ms_time)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+  IC_URING_STATE *uring= (IC_URING_STATE*)poll_set->impl_specific_ptr;
+  int ret_code;
+  guint32 i, index;
+  guint32 min_complete;
+  unsigned head, tail;
+  IC_POLL_CONNECTION *poll_conn;
+  DEBUG_ENTRY("uring_check_poll_set");
+
+  /* Rearm the sockets reported in the previous call */
+  for (i= 0; i < uring->num_rearm; i++)
+  {
+    index= uring->rearm_index[i];
+    poll_conn= poll_set->poll_connections[index];
+    ic_assert(poll_conn);
+    if ((ret_code= uring_arm_connection(uring, poll_conn->fd, index)))
+      goto error;
+  }
+  uring->num_rearm= 0;
+
+  ms_time= start_check_poll_set(poll_set, ms_time);
+  if (uring->next_ready_read < uring->num_ready_reads)
+    ms_time= 0; /* Reads left from a removed socket */
+  head= *uring->cq_head;
+  tail= (unsigned)g_atomic_int_get((gint*)uring->cq_tail);
+  min_complete= (head == tail && ms_time != 0) ? 1 : 0;
+  if (uring->num_unsubmitted || min_complete)
+  {
+    if ((ret_code= uring_enter(uring,
+                               uring->num_unsubmitted,
+                               min_complete,
+                               ms_time)))
+      goto error;
+    uring->num_unsubmitted= 0;
+  }
+  uring_reap_completions(poll_set, uring);
+  poll_set->poll_scan_ongoing= TRUE;
+  DEBUG_RETURN_INT(0);
+
+error:
+  poll_set->poll_scan_ongoing= FALSE;
+  DEBUG_RETURN_INT(ret_code);
+}
+
+static void
+uring_unmap(IC_URING_STATE *uring)
+{
+  if (uring->sqes)
+    munmap(uring->sqes, uring->sqes_size);
+  if (uring->cq_ring_ptr && uring->cq_ring_ptr != uring->sq_ring_ptr)
+    munmap(uring->cq_ring_ptr, uring->cq_ring_size);
+  if (uring->sq_ring_ptr)
+    munmap(uring->sq_ring_ptr, uring->sq_ring_size);
+}
+
+static void
+uring_free_poll_set(IC_POLL_SET *ext_poll_set)
+{
+  IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
+
+  if (poll_set->impl_specific_ptr)
+    uring_unmap((IC_URING_STATE*)poll_set->impl_specific_ptr);
+  free_poll_set(ext_poll_set);
+}
+
+static int
+uring_map_rings(IC_URING_STATE *uring, struct io_uring_params *params)
+{
+  gchar *sq_ptr, *cq_ptr;
+
+  uring->sq_ring_size= params->sq_off.array +
+                       params->sq_entries * sizeof(unsigned);
+  uring->cq_ring_size= params->cq_off.cqes +
+                       params->cq_entries * sizeof(struct io_uring_cqe);
+  if (params->features & IORING_FEAT_SINGLE_MMAP)
+  {
+    uring->sq_ring_size= IC_MAX(uring->sq_ring_size, uring->cq_ring_size);
+    uring->cq_ring_size= uring->sq_ring_size;
+  }
+  sq_ptr= mmap(NULL, uring->sq_ring_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, uring->ring_fd, IORING_OFF_SQ_RING);
+  if (sq_ptr == MAP_FAILED)
+    return 1;
+  uring->sq_ring_ptr= sq_ptr;
+  if (params->features & IORING_FEAT_SINGLE_MMAP)
+    cq_ptr= sq_ptr;
+  else
+  {
+    cq_ptr= mmap(NULL, uring->cq_ring_size, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, uring->ring_fd,
+                 IORING_OFF_CQ_RING);
+    if (cq_ptr == MAP_FAILED)
+      return 1;
+  }
+  uring->cq_ring_ptr= cq_ptr;
+  uring->sqes_size= params->sq_entries * sizeof(struct io_uring_sqe);
+  uring->sqes= mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, uring->ring_fd,
+                    IORING_OFF_SQES);
+  if (uring->sqes == MAP_FAILED)
+  {
+    uring->sqes= NULL;
+    return 1;
+  }
+  uring->sq_entries= params->sq_entries;
+  uring->sq_head= (unsigned*)(sq_ptr + params->sq_off.head);
+  uring->sq_tail= (unsigned*)(sq_ptr + params->sq_off.tail);
+  uring->sq_mask= (unsigned*)(sq_ptr + params->sq_off.ring_mask);
+  uring->sq_array= (unsigned*)(sq_ptr + params->sq_off.array);
+  uring->cq_head= (unsigned*)(cq_ptr + params->cq_off.head);
+  uring->cq_tail= (unsigned*)(cq_ptr + params->cq_off.tail);
+  uring->cq_mask= (unsigned*)(cq_ptr + params->cq_off.ring_mask);
+  uring->cqes= (struct io_uring_cqe*)(cq_ptr + params->cq_off.cqes);
+  return 0;
+}
+
+static IC_POLL_SET*
+uring_create_poll_set()
+{
+  IC_INT_POLL_SET *poll_set= NULL;
+  IC_URING_STATE *uring;
+  struct io_uring_params params;
+  int ring_fd;
+  guint32 i;
+  DEBUG_ENTRY("uring_create_poll_set");
+
+  ic_zero(&params, sizeof(params));
+  if ((ring_fd= (int)syscall(__NR_io_uring_setup,
+                             IC_URING_ENTRIES,
+                             &params)) < 0)
+  {
+    DEBUG_PRINT(COMM_LEVEL, ("io_uring not available, error %d",
+                ic_get_last_error()));
+    goto end;
+  }
+  if (!(params.features & IORING_FEAT_EXT_ARG))
+  {
+    DEBUG_PRINT(COMM_LEVEL, ("io_uring lacks support for wait timeouts"));
+    ic_close_socket(ring_fd);
+    goto end;
+  }
+  if (alloc_poll_set(&poll_set))
+  {
+    ic_close_socket(ring_fd);
+    goto end;
+  }
+  /* The number of slots is limited by the ring size */
+  poll_set->max_connections= IC_URING_MAX_CONNECTIONS;
+  /* io_uring has state and a fd to close at free time */
+  poll_set->poll_set_fd= ring_fd;
+  poll_set->need_close_at_free= TRUE;
+  if (!(uring= (IC_URING_STATE*)ic_calloc(sizeof(IC_URING_STATE))))
+    goto error;
+  poll_set->impl_specific_ptr= uring;
+  uring->ring_fd= ring_fd;
+  if (uring_map_rings(uring, &params))
+    goto error;
+  for (i= 0; i < IC_URING_MAX_WRITES; i++)
+    uring->free_write_index[i]= i;
+  uring->num_free_writes= IC_URING_MAX_WRITES;
+
+  set_common_methods(poll_set);
+  poll_set->poll_ops.ic_free_poll_set= uring_free_poll_set;
+  poll_set->poll_ops.ic_poll_set_add_connection=
+    uring_poll_set_add_connection;
+  poll_set->poll_ops.ic_poll_set_remove_connection=
+    uring_poll_set_remove_connection;
+  poll_set->poll_ops.ic_check_poll_set= uring_check_poll_set;
+  poll_set->poll_ops.ic_poll_set_has_async_write=
+    uring_poll_set_has_async_write;
+  poll_set->poll_ops.ic_poll_set_async_writev= uring_poll_set_async_writev;
+  poll_set->poll_ops.ic_get_next_write= uring_get_next_write;
+  poll_set->poll_ops.ic_poll_set_register_write_buffers=
+    uring_poll_set_register_write_buffers;
+  poll_set->poll_ops.ic_poll_set_cancel_write= uring_poll_set_cancel_write;
+  poll_set->poll_ops.ic_poll_set_has_async_read=
+    uring_poll_set_has_async_read;
+  poll_set->poll_ops.ic_poll_set_provide_read_buffer=
+    uring_poll_set_provide_read_buffer;
+  poll_set->poll_ops.ic_get_next_read= uring_get_next_read;
+end:
+  DEBUG_RETURN_PTR((IC_POLL_SET*)poll_set);
+
+error:
+  uring_free_poll_set((IC_POLL_SET*)poll_set);
+  poll_set= NULL;
+  goto end;
+}
+#endif
+
+IC_POLL_SET* ic_create_poll_set()
+{
+#ifdef HAVE_IO_URING
+  IC_POLL_SET *poll_set;
+
+  if ((poll_set= uring_create_poll_set()))
+    return poll_set;
+  /* io_uring isn't usable on this system, fall back to epoll */
+#endif
+  return epoll_create_poll_set();
+}
 #else
 #ifdef HAVE_PORT_CREATE
 #include <port.h>
@@ -443,6 +1624,7 @@ eventports_check_poll_set(IC_POLL_SET *ext_poll_set, int ms_time)
   IC_POLL_CONNECTION *poll_conn;
   DEBUG_ENTRY("eventports_check_poll_set");
 
+  ms_time= start_check_poll_set(poll_set, ms_time);
   timeout.tv_sec= 0;
   timeout.tv_nsec= ms_time * 1000000;
   if ((ret_code= port_getn(poll_set->poll_set_fd,
@@ -477,21 +1659,15 @@ eventports_check_poll_set(IC_POLL_SET *ext_poll_set, int ms_time)
   {
     index= (guint32)rec_event[i].portev_user;
     poll_conn= poll_set->poll_connections[index];
-    poll_set->ready_connections[i]= poll_conn;
     if ((ret_code= port_associate(poll_set->poll_set_fd,
                                   PORT_SOURCE_FD,
                                   poll_conn->fd,
                                   POLLIN,
                                   (void*)index)) < 0)
-    {
       ret_code= ic_get_last_error();
-      poll_conn->ret_code= ret_code;
-    }
-    else
-      poll_conn->ret_code= 0;
+    add_ready_connection(poll_set, poll_conn, ret_code);
   }
   poll_set->poll_scan_ongoing= TRUE;
-  poll_set->num_ready_connections= (guint32)num_events;
   DEBUG_RETURN_INT(0);
 }
 
@@ -511,8 +1687,7 @@ IC_POLL_SET* ic_create_poll_set()
     ic_close_socket(eventport_fd);
     goto end;
   }
-  if (!(poll_set->impl_specific_ptr= ic_calloc(
-        sizeof(struct port_event_t) * MAX_POLL_SET_CONNECTIONS)))
+  if (alloc_poll_set_events(poll_set, sizeof(struct port_event_t)))
   {
     free_poll_set((IC_POLL_SET*)poll_set);
     ic_close_socket(eventport_fd);
@@ -625,6 +1800,7 @@ kqueue_check_poll_set(IC_POLL_SET *ext_poll_set, int ms_time)
   IC_POLL_CONNECTION *poll_conn;
   DEBUG_ENTRY("kqueue_check_poll_set");
 
+  ms_time= start_check_poll_set(poll_set, ms_time);
   timeout.tv_sec= 0;
   timeout.tv_nsec= ms_time * 1000000;
   if ((ret_code= kevent(poll_set->poll_set_fd,
@@ -661,12 +1837,10 @@ kqueue_check_poll_set(IC_POLL_SET *ext_poll_set, int ms_time)
     index= poll_conn->index;
     ic_require(index < poll_set->num_allocated_connections);
     poll_conn= poll_set->poll_connections[index];
-    poll_set->ready_connections[i]= poll_conn;
-    poll_conn->ret_code= 0;
+    add_ready_connection(poll_set, poll_conn, 0);
   }
   DEBUG_PRINT(CHECK_POLL_SET_LEVEL, ("num_ready_connections = %u",
-              (guint32)ret_code));
-  poll_set->num_ready_connections= (guint32)ret_code;
+              poll_set->num_ready_connections));
   poll_set->poll_scan_ongoing= TRUE;
   DEBUG_RETURN_INT(0);
 }
@@ -687,8 +1861,7 @@ IC_POLL_SET* ic_create_poll_set()
     ic_close_socket(kqueue_fd);
     goto end;
   }
-  if (!(poll_set->impl_specific_ptr= ic_calloc(
-        sizeof(struct kevent) * MAX_POLL_SET_CONNECTIONS)))
+  if (alloc_poll_set_events(poll_set, sizeof(struct kevent)))
   {
     free_poll_set((IC_POLL_SET*)poll_set);
     ic_close_socket(kqueue_fd);
@@ -772,12 +1945,16 @@ poll_poll_set_add_connection(IC_POLL_SET *ext_poll_set, int fd, void *user_obj)
   IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
   int ret_code;
   guint32 index= 0;
-  struct pollfd *poll_fd_array= (struct pollfd *)poll_set->impl_specific_ptr;
+  struct pollfd *poll_fd_array;
   DEBUG_ENTRY("poll_poll_set_add_connection");
 
   if ((ret_code= add_poll_set_member(poll_set, fd, user_obj, &index)))
     goto end;
+  /* The array might have grown when adding the member */
+  poll_fd_array= (struct pollfd *)poll_set->impl_specific_ptr;
   poll_fd_array[index].fd= fd;
+  poll_fd_array[index].events= POLLIN;
+  poll_fd_array[index].revents= 0;
 end:
   DEBUG_RETURN_INT(ret_code);
 }
@@ -804,11 +1981,11 @@ poll_check_poll_set(IC_POLL_SET *ext_poll_set, int ms_time)
 {
   IC_INT_POLL_SET *poll_set= (IC_INT_POLL_SET*)ext_poll_set;
   int ret_code;
-  guint32 i, num_ready_connections;
+  guint32 i;
   IC_POLLFD_TYPE *poll_fd_array= (IC_POLLFD_TYPE*)poll_set->impl_specific_ptr;
   DEBUG_ENTRY("poll_check_poll_set");
 
-  poll_set->num_ready_connections= 0;
+  ms_time= start_check_poll_set(poll_set, ms_time);
   poll_set->poll_scan_ongoing= TRUE;
   do
   {
@@ -819,15 +1996,8 @@ poll_check_poll_set(IC_POLL_SET *ext_poll_set, int ms_time)
       for (i= 0; i < poll_set->num_poll_connections; i++)
       {
         if (poll_fd_array[i].revents == POLLIN)
-        {
-          num_ready_connections= poll_set->num_ready_connections;
-          poll_set->ready_connections[num_ready_connections]=
-            poll_set->poll_connections[i];
-          poll_set->num_ready_connections= num_ready_connections + 1;
-          poll_set->poll_connections[i]->ret_code= 0;
-        }
+          add_ready_connection(poll_set, poll_set->poll_connections[i], 0);
       }
-      ic_assert((int)poll_set->num_ready_connections == ret_code);
       DEBUG_RETURN_INT(0);
     }
     else if (ret_code == 0)
@@ -854,8 +2024,6 @@ poll_check_poll_set(IC_POLL_SET *ext_poll_set, int ms_time)
 IC_POLL_SET* ic_create_poll_set()
 {
   IC_INT_POLL_SET *poll_set= NULL;
-  IC_POLLFD_TYPE *poll_fd_array;
-  guint32 i;
   DEBUG_ENTRY("ic_create_poll_set(poll)");
 
   if (alloc_poll_set(&poll_set))
@@ -863,20 +2031,13 @@ IC_POLL_SET* ic_create_poll_set()
     ic_printf("Failed to allocate a poll fd");
     goto end;
   }
-  if (!(poll_set->impl_specific_ptr= ic_calloc(
-      sizeof(IC_POLLFD_TYPE) * MAX_POLL_SET_CONNECTIONS)))
+  /* The events of an entry are set when a connection is added */
+  if (alloc_poll_set_events(poll_set, sizeof(IC_POLLFD_TYPE)))
   {
     free_poll_set((IC_POLL_SET*)poll_set);
     poll_set= NULL;
     goto end;
   }
-  poll_fd_array= (IC_POLLFD_TYPE*)poll_set->impl_specific_ptr;
-  for (i= 0; i < MAX_POLL_SET_CONNECTIONS; i++)
-  {
-    poll_fd_array[i].fd= 0;
-    poll_fd_array[i].events= POLLIN;
-    poll_fd_array[i].revents= 0;
-  }
   /*
     There is no common file descriptor for the poll variant. We only
     store a local state in this object and there are no file descriptors
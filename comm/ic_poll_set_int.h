@@ -26,6 +26,14 @@ struct ic_int_poll_set
     connections which have data waiting on socket connection.
   */
   IC_POLL_CONNECTION **ready_connections;
+  /*
+    An array of connections reported as not drained through
+    ic_poll_set_still_ready, these are moved to the ready list by the
+    next ic_check_poll_set.
+  */
+  IC_POLL_CONNECTION **pending_connections;
+  /* The connection last returned by ic_get_next_connection */
+  IC_POLL_CONNECTION *current_connection;
   /*
     This variable contains the array of event handlers as needed by the various
     implementations.
@@ -37,8 +45,18 @@ struct ic_int_poll_set
   guint32 num_poll_connections;
   /* Number of connections ready with data not reported yet. */
   guint32 num_ready_connections;
-  /* Maximum number of connections we can use in this poll set */
+  /* Number of connections in the pending list */
+  guint32 num_pending_connections;
+  /* Number of connections we can use in this poll set before growing */
   guint32 num_allocated_connections;
+  /* Maximum number of connections the poll set can grow to */
+  guint32 max_connections;
+  /*
+    Size of an event in the impl_specific_ptr array, the array has one
+    event per allocated connection and grows with the poll set. 0 if the
+    implementation doesn't use an event array.
+  */
+  guint32 impl_event_size;
   /* This implementation requires a common fd to be closed at free time */
   gboolean need_close_at_free;
   /*
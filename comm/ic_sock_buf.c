@@ -19,12 +19,130 @@
 #include <ic_port.h>
 #include <ic_sock_buf.h>
 
+/*
+  Thread local page caches
+  ------------------------
+  Every page allocation and release used to go through the pool mutex. To
+  avoid this each thread keeps a bounded cache of free pages per pool. The
+  cache is refilled from the global free list in batches of half the cache
+  size and when it grows beyond the cache size it is drained back to the
+  global free list, leaving half the cache size in the cache. Thus the
+  common path of getting and returning a page takes no lock at all.
+
+  The thread caches are found through thread local storage, each thread
+  has an array of caches indexed by the pool id. Since pools can be freed
+  while other threads still have pages from the pool in their cache, each
+  pool gets a unique instance number. A cache with a different instance
+  number than its pool refers to a freed pool and is simply forgotten
+  since its pages were freed together with the pool.
+*/
+struct ic_sock_buf_cache
+{
+  IC_SOCK_BUF_PAGE *first_page;
+  guint64 pool_instance;
+  guint32 num_pages;
+};
+typedef struct ic_sock_buf_cache IC_SOCK_BUF_CACHE;
+
+static void release_all_thread_caches(gpointer data);
+
+static GPrivate sock_buf_cache_priv= G_PRIVATE_INIT(release_all_thread_caches);
+static IC_MUTEX sock_buf_pool_mutex;
+static IC_SOCK_BUF *sock_buf_pools[IC_MAX_SOCK_BUF_POOLS];
+static guint64 sock_buf_pool_instance= 0;
+
 static void return_sock_buf_page(IC_SOCK_BUF *buf,
                                  IC_SOCK_BUF_PAGE *in_page);
 static IC_SOCK_BUF_PAGE* low_get_sock_buf_page(IC_SOCK_BUF *buf,
                             IC_SOCK_BUF_PAGE **free_rec_pages,
                             guint32 num_pages_to_preallocate);
 
+static IC_SOCK_BUF_CACHE*
+get_thread_cache(IC_SOCK_BUF *buf)
+{
+  IC_SOCK_BUF_CACHE *thread_caches, *cache;
+
+  if (buf->cache_size == 0)
+    return NULL;
+  thread_caches= (IC_SOCK_BUF_CACHE*)g_private_get(&sock_buf_cache_priv);
+  if (!thread_caches)
+  {
+    if (!(thread_caches= (IC_SOCK_BUF_CACHE*)ic_calloc_low(
+          IC_MAX_SOCK_BUF_POOLS * sizeof(IC_SOCK_BUF_CACHE))))
+      return NULL;
+    g_private_set(&sock_buf_cache_priv, (gpointer)thread_caches);
+  }
+  cache= &thread_caches[buf->pool_id];
+  if (cache->pool_instance != buf->pool_instance)
+  {
+    /* Cache refers to an already freed pool, forget about its pages */
+    cache->first_page= NULL;
+    cache->num_pages= 0;
+    cache->pool_instance= buf->pool_instance;
+  }
+  return cache;
+}
+
+/*
+  Retrieve a linked list of at most num_pages pages from the global free
+  list. The list is ended by a NULL pointer and the number of pages
+  retrieved is returned in num_pages_allocated.
+*/
+static IC_SOCK_BUF_PAGE*
+get_global_pages(IC_SOCK_BUF *buf,
+                 guint32 num_pages,
+                 guint32 *num_pages_allocated)
+{
+  guint32 i;
+  IC_SOCK_BUF_PAGE *first_page, *next_page, *last_page;
+
+  ic_assert(num_pages > 0);
+  last_page= NULL;
+  ic_mutex_lock(buf->ic_buf_mutex);
+  first_page= buf->first_page;
+  next_page= first_page;
+  for (i= 0; i < num_pages && next_page; i++)
+  {
+    last_page= next_page;
+    next_page= next_page->next_sock_buf_page;
+  }
+  buf->first_page= next_page;
+  ic_mutex_unlock(buf->ic_buf_mutex);
+
+  if (last_page)
+    last_page->next_sock_buf_page= NULL;
+  *num_pages_allocated= i;
+  /* Initialise the returned page objects */
+  for (next_page= first_page;
+       next_page;
+       next_page= next_page->next_sock_buf_page)
+  {
+    next_page->size= 0;
+    next_page->ref_count= 0;
+  }
+  return first_page;
+}
+
+/* Insert a linked list of pages first in the global free list */
+static void
+put_global_pages(IC_SOCK_BUF *buf,
+                 IC_SOCK_BUF_PAGE *first_page,
+                 IC_SOCK_BUF_PAGE *last_page)
+{
+  ic_mutex_lock(buf->ic_buf_mutex);
+  last_page->next_sock_buf_page= buf->first_page;
+  buf->first_page= first_page;
+  ic_mutex_unlock(buf->ic_buf_mutex);
+}
+
+static IC_SOCK_BUF_PAGE*
+get_last_page(IC_SOCK_BUF_PAGE *page)
+{
+  while (page->next_sock_buf_page)
+    page= page->next_sock_buf_page;
+  return page;
+}
+
 static IC_SOCK_BUF_PAGE*
 get_sock_buf_page(IC_SOCK_BUF *buf,
                   guint32 buf_size,
@@ -69,70 +187,57 @@ low_get_sock_buf_page(IC_SOCK_BUF *buf,
                       IC_SOCK_BUF_PAGE **free_rec_pages,
                       guint32 num_pages_to_preallocate)
 {
-  guint32 i;
-  IC_SOCK_BUF_PAGE *first_page, *next_page, *last_page;
+  guint32 num_pages;
+  IC_SOCK_BUF_PAGE *first_page;
+  IC_SOCK_BUF_CACHE *cache;
 
-  if (free_rec_pages)
+  cache= get_thread_cache(buf);
+  if (free_rec_pages && (*free_rec_pages || !cache || !cache->first_page))
   {
-    if (*free_rec_pages)
+    if (!*free_rec_pages)
     {
       /*
         We allow the caller to provide a local linked list of free
         objects and thus the caller can fetch objects from the
         global list in batches.
       */
-      first_page= *free_rec_pages;
-      *free_rec_pages= (*free_rec_pages)->next_sock_buf_page;
-      first_page->next_sock_buf_page= NULL;
-      return first_page;
+      if (!(*free_rec_pages= get_global_pages(buf,
+                                              num_pages_to_preallocate,
+                                              &num_pages)))
+        return NULL;
     }
+    first_page= *free_rec_pages;
   }
-  else
-  {
-    /* Ignore this parameter if no local free list provided */
-    num_pages_to_preallocate= 1;
-  }
-
-  ic_mutex_lock(buf->ic_buf_mutex);
-  /* Retrieve objects in a linked list */
-  first_page= buf->first_page;
-  next_page= first_page;
-  for (i= 0; i < num_pages_to_preallocate && next_page; i++)
-    next_page= next_page->next_sock_buf_page;
-  buf->first_page= next_page;
-  ic_mutex_unlock(buf->ic_buf_mutex);
-
-  /* Initialise the returned page objects */
-  next_page= first_page;
-  last_page= NULL;
-  ic_assert(num_pages_to_preallocate > 0);
-  for (i= 0; i < num_pages_to_preallocate && next_page; i++)
-  {
-    next_page->size= 0;
-    next_page->ref_count= 0;
-    last_page= next_page;
-    next_page= next_page->next_sock_buf_page;
-  }
-  /* Initialise local free list */
-  if (free_rec_pages && first_page)
+  else if (cache)
   {
     /*
-      The preallocated list if any must be ended with a NULL pointer.
-      It must be also initialised to the first preallocated page. It's
-      important to not perform any action at all if no pages have been
-      preallocated which is noted by that last_page is different than
-      the first_page, this means we were successful in preallocating at
-      least one page.
+      Pages returned by this thread are in the thread cache, use those
+      first also when the caller has an empty local free list.
     */
-    if (last_page != first_page)
+    if (!cache->first_page)
     {
-      *free_rec_pages= first_page->next_sock_buf_page;
-      last_page->next_sock_buf_page= NULL;
+      /* Refill the thread cache with a batch from the global list */
+      if (!(cache->first_page= get_global_pages(buf,
+                                                buf->cache_size / 2,
+                                                &cache->num_pages)))
+        return NULL;
     }
-  }
-  /* Unlink first page from list */
-  if (first_page)
+    first_page= cache->first_page;
+    cache->first_page= first_page->next_sock_buf_page;
+    cache->num_pages--;
     first_page->next_sock_buf_page= NULL;
+    first_page->size= 0;
+    first_page->ref_count= 0;
+    return first_page;
+  }
+  else
+  {
+    /* Ignore this parameter if no local free list provided */
+    return get_global_pages(buf, (guint32)1, &num_pages);
+  }
+  /* Unlink first page from local free list */
+  *free_rec_pages= first_page->next_sock_buf_page;
+  first_page->next_sock_buf_page= NULL;
   return first_page;
 }
 
@@ -177,15 +282,18 @@ return_sock_buf_page(IC_SOCK_BUF *buf,
 {
   IC_SOCK_BUF_PAGE *prev_page;
   IC_SOCK_BUF_PAGE *next_page;
+  IC_SOCK_BUF_CACHE *cache;
   guint32 page_size, this_page_size;
-  register IC_SOCK_BUF_PAGE *page= in_page;
+  guint32 i, keep_pages;
+  guint32 num_pages= 0;
+  IC_SOCK_BUF_PAGE *page= in_page;
 
   ic_require(page);
   page_size= buf->page_size;
   prev_page= NULL;
   /**
     We start by creating a linked list of pages, then we insert the
-    linked list all in one go into the global list.
+    linked list all in one go into the thread cache or the global list.
   */
   do
   {
@@ -225,11 +333,146 @@ return_sock_buf_page(IC_SOCK_BUF *buf,
       page->sock_buf= NULL;
     }
     page= next_page;
+    num_pages++;
   } while (page != NULL);
-  ic_mutex_lock(buf->ic_buf_mutex);
-  prev_page->next_sock_buf_page= buf->first_page;
-  buf->first_page= in_page;
-  ic_mutex_unlock(buf->ic_buf_mutex);
+  /*
+    The list is now reversed, prev_page is the first page in the list and
+    in_page is the last page in the list.
+  */
+  if (!(cache= get_thread_cache(buf)))
+  {
+    put_global_pages(buf, prev_page, in_page);
+    return;
+  }
+  in_page->next_sock_buf_page= cache->first_page;
+  cache->first_page= prev_page;
+  cache->num_pages+= num_pages;
+  if (cache->num_pages <= buf->cache_size)
+    return;
+  /*
+    The cache is full, keep half the cache size in the cache and drain
+    the rest back to the global free list.
+  */
+  keep_pages= buf->cache_size / 2;
+  page= cache->first_page;
+  for (i= 1; i < keep_pages; i++)
+    page= page->next_sock_buf_page;
+  next_page= page->next_sock_buf_page;
+  page->next_sock_buf_page= NULL;
+  cache->num_pages= keep_pages;
+  put_global_pages(buf, next_page, get_last_page(next_page));
+}
+
+static void
+release_thread_cache(IC_SOCK_BUF *buf)
+{
+  IC_SOCK_BUF_CACHE *cache;
+  IC_SOCK_BUF_PAGE *first_page;
+
+  /* Don't allocate caches for a thread that never returned a page */
+  if (!g_private_get(&sock_buf_cache_priv) ||
+      !(cache= get_thread_cache(buf)) ||
+      !cache->first_page)
+    return;
+  first_page= cache->first_page;
+  cache->first_page= NULL;
+  cache->num_pages= 0;
+  put_global_pages(buf, first_page, get_last_page(first_page));
+}
+
+/*
+  Return the pages in all caches of a thread to the global free lists.
+  We hold the pool array mutex to ensure that the pool isn't freed while
+  we're returning the pages. At thread exit the debug state of the thread
+  is already released, so only the low mutex routines can be used.
+*/
+static void
+return_thread_caches(IC_SOCK_BUF_CACHE *thread_caches)
+{
+  guint32 i;
+  IC_SOCK_BUF *buf;
+  IC_SOCK_BUF_CACHE *cache;
+  IC_SOCK_BUF_PAGE *last_page;
+
+  ic_mutex_lock_low(&sock_buf_pool_mutex);
+  for (i= 0; i < IC_MAX_SOCK_BUF_POOLS; i++)
+  {
+    cache= &thread_caches[i];
+    buf= sock_buf_pools[i];
+    if (cache->first_page &&
+        buf &&
+        buf->pool_instance == cache->pool_instance)
+    {
+      last_page= get_last_page(cache->first_page);
+      ic_mutex_lock_low(buf->ic_buf_mutex);
+      last_page->next_sock_buf_page= buf->first_page;
+      buf->first_page= cache->first_page;
+      ic_mutex_unlock_low(buf->ic_buf_mutex);
+    }
+    cache->first_page= NULL;
+    cache->num_pages= 0;
+  }
+  ic_mutex_unlock_low(&sock_buf_pool_mutex);
+}
+
+static void
+release_all_thread_caches(gpointer data)
+{
+  IC_SOCK_BUF_CACHE *thread_caches= (IC_SOCK_BUF_CACHE*)data;
+
+  return_thread_caches(thread_caches);
+  ic_free_low((void*)thread_caches);
+}
+
+void
+ic_release_all_thread_caches()
+{
+  IC_SOCK_BUF_CACHE *thread_caches;
+
+  if ((thread_caches= (IC_SOCK_BUF_CACHE*)
+       g_private_get(&sock_buf_cache_priv)))
+    return_thread_caches(thread_caches);
+}
+
+static void
+register_sock_buf_pool(IC_SOCK_BUF *buf, guint64 no_of_pages)
+{
+  guint32 i;
+  guint64 cache_size;
+
+  cache_size= no_of_pages / IC_SOCK_BUF_CACHE_DIVISOR;
+  if (cache_size > IC_SOCK_BUF_MAX_CACHE_SIZE)
+    cache_size= IC_SOCK_BUF_MAX_CACHE_SIZE;
+  ic_mutex_lock_low(&sock_buf_pool_mutex);
+  buf->pool_instance= ++sock_buf_pool_instance;
+  for (i= 0; i < IC_MAX_SOCK_BUF_POOLS; i++)
+  {
+    if (!sock_buf_pools[i])
+      break;
+  }
+  if (i == IC_MAX_SOCK_BUF_POOLS || cache_size < 2)
+  {
+    /* Pool too small or too many pools, no thread cache used */
+    buf->pool_id= IC_MAX_SOCK_BUF_POOLS;
+    buf->cache_size= 0;
+  }
+  else
+  {
+    sock_buf_pools[i]= buf;
+    buf->pool_id= i;
+    buf->cache_size= (guint32)cache_size;
+  }
+  ic_mutex_unlock_low(&sock_buf_pool_mutex);
+}
+
+static void
+unregister_sock_buf_pool(IC_SOCK_BUF *buf)
+{
+  if (buf->pool_id == IC_MAX_SOCK_BUF_POOLS)
+    return;
+  ic_mutex_lock_low(&sock_buf_pool_mutex);
+  sock_buf_pools[buf->pool_id]= NULL;
+  ic_mutex_unlock_low(&sock_buf_pool_mutex);
 }
 
 void
@@ -239,6 +482,7 @@ free_sock_buf(IC_SOCK_BUF *buf)
   guint32 alloc_segments= buf->alloc_segments;
   DEBUG_ENTRY("free_sock_buf");
 
+  unregister_sock_buf_pool(buf);
   ic_mutex_destroy(&buf->ic_buf_mutex);
   for (i= 0; i < alloc_segments; i++)
     ic_free(buf->alloc_segments_ref[i]);
@@ -304,6 +548,7 @@ inc_sock_buf(IC_SOCK_BUF *buf, guint64 no_of_pages)
     last_sock_buf_page->next_sock_buf_page= buf->first_page;
     buf->first_page= (IC_SOCK_BUF_PAGE*)ptr;
     buf->alloc_segments_ref[buf->alloc_segments]= ptr;
+    buf->alloc_segments_pages[buf->alloc_segments]= no_of_pages;
     buf->alloc_segments++;
   }
   else
@@ -315,6 +560,42 @@ inc_sock_buf(IC_SOCK_BUF *buf, guint64 no_of_pages)
   return error;
 }
 
+/*
+  The buffer area of a segment is placed after its page objects, pools
+  without a page size keep their data in the page objects. An area is
+  split on page boundaries when its size doesn't fit in an IC_IOVEC.
+*/
+static guint32
+get_buffer_areas(IC_SOCK_BUF *buf, IC_IOVEC *areas, guint32 max_areas)
+{
+  guint32 i, num_areas= 0;
+  guint64 no_of_pages, area_pages;
+  guint64 max_area_pages;
+  gchar *area_ptr;
+
+  if (buf->page_size == 0)
+    return 0;
+  max_area_pages= G_MAXUINT32 / buf->page_size;
+  ic_mutex_lock(buf->ic_buf_mutex);
+  for (i= 0; i < buf->alloc_segments; i++)
+  {
+    no_of_pages= buf->alloc_segments_pages[i];
+    area_ptr= buf->alloc_segments_ref[i] +
+              (no_of_pages * IC_STD_CACHE_LINE_SIZE);
+    while (no_of_pages && num_areas < max_areas)
+    {
+      area_pages= IC_MIN(no_of_pages, max_area_pages);
+      areas[num_areas].iov_base= area_ptr;
+      areas[num_areas].iov_len= (guint32)(area_pages * buf->page_size);
+      num_areas++;
+      area_ptr+= area_pages * buf->page_size;
+      no_of_pages-= area_pages;
+    }
+  }
+  ic_mutex_unlock(buf->ic_buf_mutex);
+  return num_areas;
+}
+
 IC_SOCK_BUF*
 ic_create_sock_buf(guint32 page_size,
                    guint64 no_of_pages)
@@ -346,13 +627,17 @@ ic_create_sock_buf(guint32 page_size,
 
   buf->first_page= (IC_SOCK_BUF_PAGE*)ptr;
   buf->alloc_segments_ref[0]= ptr;
+  buf->alloc_segments_pages[0]= no_of_pages;
   buf->alloc_segments= 1;
   buf->page_size= page_size;
+  register_sock_buf_pool(buf, no_of_pages);
 
   buf->sock_buf_ops.ic_get_sock_buf_page= get_sock_buf_page;
   buf->sock_buf_ops.ic_get_sock_buf_page_wait= get_sock_buf_page_wait;
   buf->sock_buf_ops.ic_return_sock_buf_page= return_sock_buf_page;
   buf->sock_buf_ops.ic_inc_sock_buf= inc_sock_buf;
+  buf->sock_buf_ops.ic_release_thread_cache= release_thread_cache;
+  buf->sock_buf_ops.ic_get_buffer_areas= get_buffer_areas;
   buf->sock_buf_ops.ic_free_sock_buf= free_sock_buf;
   return buf;
 
@@ -362,3 +647,22 @@ error:
   ic_free(buf);
   return NULL;
 }
+
+IC_SOCK_BUF*
+ic_create_local_sock_buf(guint32 page_size,
+                         guint64 no_of_pages)
+{
+  IC_SOCK_BUF *buf;
+
+  if (!(buf= ic_create_sock_buf(page_size, no_of_pages)))
+    return NULL;
+  /*
+    The page objects were written when setting up the free list, the
+    buffer areas placed after the page objects are still untouched.
+  */
+  if (page_size)
+    ic_zero(buf->alloc_segments_ref[0] +
+            (no_of_pages * IC_STD_CACHE_LINE_SIZE),
+            (size_t)(page_size * no_of_pages));
+  return buf;
+}
@@ -54,6 +54,7 @@
 */
 typedef struct ic_apid_global IC_APID_GLOBAL;
 typedef struct ic_apid_global_ops IC_APID_GLOBAL_OPS;
+typedef struct ic_apid_node_send_stats IC_APID_NODE_SEND_STATS;
 typedef struct ic_metadata_bind_ops IC_METADATA_BIND_OPS;
 
 typedef struct ic_apid_connection IC_APID_CONNECTION;
@@ -109,6 +110,9 @@ typedef enum ic_read_key_query_type IC_READ_KEY_QUERY_TYPE;
 typedef enum ic_write_key_query_type IC_WRITE_KEY_QUERY_TYPE;
 typedef enum ic_scan_query_type IC_SCAN_QUERY_TYPE;
 
+/* State returned when asking a scan for its next record */
+typedef enum ic_scan_row_state IC_SCAN_ROW_STATE;
+
 /* State returned when asking transaction for its commit state */
 typedef enum ic_commit_state IC_COMMIT_STATE;
 
@@ -733,6 +737,24 @@ struct ic_apid_query_ops
   int (*ic_set_partition_id) (IC_APID_QUERY *apid_query,
                               guint32 partition_id);
 
+  /*
+    Scan parallelism and batch size
+    -------------------------------
+    A scan is sent to all fragments to scan in parallel at once, each
+    fragment sends up to batch_size records before it waits for the API
+    to ask for the next batch. The API asks for the next batch of a
+    fragment when the user has read all records of its current batch,
+    so at most one batch per fragment is buffered in the API. The other
+    fragments keep delivering while one batch is read.
+
+    A parallelism of 0 scans all fragments of the table in parallel, a
+    batch size of 0 uses the default batch size. The parallelism can be
+    at most 255 and the batch size at most 1023.
+  */
+  int (*ic_set_scan_parallelism) (IC_APID_QUERY *apid_query,
+                                  guint32 parallelism,
+                                  guint32 batch_size);
+
   /*
     Handling of RANGE CONDITION objects
     -----------------------------------
@@ -750,6 +772,36 @@ struct ic_apid_query_ops
                          (IC_APID_QUERY *apid_query);
   void (*ic_keep_range) (IC_APID_QUERY *apid_query);
 
+  /*
+    A scan over multiple ranges is sent as one scan, each record returned
+    carries the id of the range it was found in. This returns the range id
+    of the current record of the scan.
+  */
+  guint32 (*ic_get_range_id) (IC_APID_QUERY *apid_query);
+
+  /*
+    Reading the records of a scan
+    -----------------------------
+    A scan query is reported as executed, through ic_get_next_executed_query
+    or its callback, each time it has records ready to be read and finally
+    when the scan has ended. The records are read one at a time by calling
+    ic_get_next_scan_row until it doesn't return IC_SCAN_ROW_READY.
+
+    IC_SCAN_ROW_READY means that the next record is placed in the buffer
+    values and null buffer of the query. Fields not stored inline point
+    into buffers owned by the API, they are valid until the next call to
+    ic_get_next_scan_row.
+
+    IC_SCAN_NO_ROW_READY means that all records received so far have been
+    read, the next batches are requested from the fragments read at the
+    next send or poll on the connection and the query is reported again
+    when more records have arrived.
+
+    IC_SCAN_END means that the scan has ended, any_error is set if it
+    ended due to an error.
+  */
+  IC_SCAN_ROW_STATE (*ic_get_next_scan_row) (IC_APID_QUERY *apid_query);
+
   /*
     Handling of WHERE CONDITION objects
     -----------------------------------
@@ -1416,6 +1468,52 @@ struct ic_apid_connection_ops
                 IC_APID_CALLBACK_FUNC callback_func,
                 /* Any reference the user wants to pass to completion phase */
                 void *user_reference);
+
+  /*
+    Write key query array
+    Define a batch of write key queries of the same type in one call, this
+    is equivalent to calling ic_write_key once per query. All queries
+    defined before the next ic_send or ic_flush are sent together, one
+    message per query but with all messages to the same data node sent
+    in one go. The user_references array can be NULL, otherwise it has
+    one reference per query.
+  */
+  int (*ic_write_key_array)
+                /* Our thread representation */
+               (IC_APID_CONNECTION *apid_conn,
+                /* Array of query objects */
+                IC_APID_QUERY **apid_queries,
+                /* Number of query objects in array */
+                guint32 num_queries,
+                /* Transaction object, can span multiple threads */
+                IC_TRANSACTION *transaction_obj,
+                /* Type of write query */
+                IC_WRITE_KEY_QUERY_TYPE write_key_query_type,
+                /* Callback function, called once per query */
+                IC_APID_CALLBACK_FUNC callback_func,
+                /* Array of references to pass to completion phase */
+                void **user_references);
+
+  /*
+    Read key query array
+    Works in exactly the same manner as ic_write_key_array except that it
+    defines read queries instead.
+  */
+  int (*ic_read_key_array)
+                /* Our thread representation */
+               (IC_APID_CONNECTION *apid_conn,
+                /* Array of query objects */
+                IC_APID_QUERY **apid_queries,
+                /* Number of query objects in array */
+                guint32 num_queries,
+                /* Transaction object, can span multiple threads */
+                IC_TRANSACTION *transaction_obj,
+                /* Type of read query */
+                IC_READ_KEY_QUERY_TYPE read_key_query_type,
+                /* Callback function, called once per query */
+                IC_APID_CALLBACK_FUNC callback_func,
+                /* Array of references to pass to completion phase */
+                void **user_references);
   /*
     Scan table query
     This method is used to scan a table, one can either scan a non-unique
@@ -1624,7 +1722,13 @@ struct ic_transaction_ops
 
 struct ic_transaction_hint_ops
 {
-  int (*ic_define_hint) (IC_TRANSACTION_HINT *trans_hint);
+  /*
+    Define the hint from the primary key defined in a query object, the
+    transaction is then started on the data node with the primary replica
+    of the partition this key belongs to.
+  */
+  int (*ic_define_hint) (IC_TRANSACTION_HINT *trans_hint,
+                         IC_APID_QUERY *apid_query);
 };
 
 struct ic_apid_error_ops
@@ -1675,6 +1779,27 @@ struct ic_apid_error_ops
   of the Data API.
 */
 
+/*
+  Send statistics of the connection to a node in a cluster. max_num_waits
+  is the current batching decision of the adaptive send algorithm, this is
+  the number of non-forced sends that can be held back to be sent together
+  with later messages. num_waits is the number of sends currently held back.
+  p95_wait_nanos and p99_wait_nanos are the 95th and 99th percentile of the
+  send delay at the current batching level as measured by the algorithm
+  over num_samples sends. latency_budget_nanos is the send delay that 95%
+  of the sends should stay within.
+*/
+struct ic_apid_node_send_stats
+{
+  guint64 latency_budget_nanos;
+  guint64 p95_wait_nanos;
+  guint64 p99_wait_nanos;
+  guint32 max_num_waits;
+  guint32 num_waits;
+  guint32 num_samples;
+  guint32 queued_bytes;
+};
+
 struct ic_apid_global_ops
 {
   /*
@@ -1744,6 +1869,22 @@ struct ic_apid_global_ops
                                 guint32 cluster_id,
                                 guint32 *node_id);
 
+  /*
+    Set the latency budget of the adaptive send algorithm for all nodes in
+    the cluster. 95% of the non-forced sends should not be delayed longer
+    than this. Setting it to 0 disables the adaptive send algorithm. The
+    default is the socket_max_wait_in_nanos of the socket configuration.
+  */
+  int (*ic_set_send_latency_budget) (IC_APID_GLOBAL *apid_global,
+                                     guint32 cluster_id,
+                                     guint32 budget_in_nanos);
+
+  /* Get the send statistics of the connection to a node in a cluster */
+  int (*ic_get_node_send_stats) (IC_APID_GLOBAL *apid_global,
+                                 guint32 cluster_id,
+                                 guint32 node_id,
+                                 IC_APID_NODE_SEND_STATS *stats);
+
   /* Free the IC_APID_GLOBAL object */
   void (*ic_free_apid_global) (IC_APID_GLOBAL *apid_global);
 };
@@ -1789,6 +1930,12 @@ struct ic_apid_global_ops
   Creation of these objects and deciding whether to use a global pool or
   a local pool per thread is a decision by the user, or even to create
   and destroy these objects per query.
+
+  ic_init_transaction_hint
+  ------------------------
+  Method to initialise a transaction hint object owned by the user, the
+  hint is defined from a query object with its primary key defined and
+  is used when starting a transaction.
 */
 IC_APID_GLOBAL* ic_create_apid_global(IC_API_CONFIG_SERVER *apic,
                                       gboolean use_external_connect,
@@ -1820,6 +1967,8 @@ ic_create_alter_table(IC_METADATA_TRANSACTION *md_trans);
 IC_ALTER_TABLESPACE*
 ic_create_alter_tablespace(IC_METADATA_TRANSACTION *md_trans);
 
+void ic_init_transaction_hint(IC_TRANSACTION_HINT *trans_hint);
+
 /*
   EXTERNALLY VISIBLE DATA STRUCTURES
   ----------------------------------
@@ -1953,6 +2102,12 @@ extern gchar *ic_glob_version_path;
 extern guint32 ic_glob_node_id;
 extern guint32 ic_glob_cs_timeout;
 extern guint32 ic_glob_num_threads;
+extern guint32 ic_glob_num_receive_threads;
+extern guint32 ic_glob_numa_placement;
+extern guint32 ic_glob_receive_cpu_cores;
+extern guint32 ic_glob_send_cpu_cores;
+extern guint32 ic_glob_user_busy_poll;
+extern guint32 ic_glob_receive_busy_poll;
 extern guint32 ic_glob_use_iclaustron_cluster_server;
 extern guint32 ic_glob_daemonize;
 extern guint32 ic_glob_byte_order;
@@ -54,6 +54,17 @@ enum ic_scan_query_type
   IC_SCAN_CONSISTENT_READ= 3
 };
 
+/*
+  State returned when asking a scan query for its next record, see
+  ic_get_next_scan_row.
+*/
+enum ic_scan_row_state
+{
+  IC_SCAN_ROW_READY= 0,
+  IC_SCAN_NO_ROW_READY= 1,
+  IC_SCAN_END= 2
+};
+
 enum ic_lower_range_type
 {
   IC_NO_MINIMUM= 0,
@@ -185,6 +185,9 @@ static const int CREATE_HASH_MAP_IF_NOT_EXISTS= 1;
 static const int CREATE_HASH_MAP_DEFAULT= 2;
 static const int CREATE_HASH_MAP_REORG= 4;
 
+/* Number of buckets in hash maps created by default */
+#define IC_DEFAULT_HASH_MAP_BUCKETS 3840
+
 typedef struct ic_create_hash_map_conf IC_CREATE_HASH_MAP_CONF;
 struct ic_create_hash_map_conf
 {
@@ -13,3 +13,251 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA */
 
+
+/*
+  Messages used by the primary key query protocol and the protocol to
+  connect to a transaction record in the data node. The layout of the
+  messages is described together with the code handling them in
+  ic_apid_handle_messages.ic.
+*/
+
+/* Connect to a transaction record messages */
+static const int NDB_CONNECTREQ_GSN= 39;
+static const int NDB_CONNECTCONF_GSN= 37;
+static const int NDB_CONNECTREF_GSN= 38;
+
+typedef struct ic_ndb_connectreq IC_NDB_CONNECTREQ;
+struct ic_ndb_connectreq
+{
+  guint32 my_trans_ref;
+  guint32 my_reference;
+};
+static const int NDB_CONNECTREQ_LEN=
+  sizeof(IC_NDB_CONNECTREQ)/sizeof(guint32);
+
+typedef struct ic_ndb_connectconf IC_NDB_CONNECTCONF;
+struct ic_ndb_connectconf
+{
+  guint32 my_trans_ref;
+  guint32 ndb_trans_ref;
+};
+static const int NDB_CONNECTCONF_LEN=
+  sizeof(IC_NDB_CONNECTCONF)/sizeof(guint32);
+
+typedef struct ic_ndb_connectref IC_NDB_CONNECTREF;
+struct ic_ndb_connectref
+{
+  guint32 my_trans_ref;
+  guint32 error_code;
+};
+static const int NDB_CONNECTREF_LEN=
+  sizeof(IC_NDB_CONNECTREF)/sizeof(guint32);
+
+/* Release a transaction record messages */
+static const int NDB_DISCONNECTREQ_GSN= 36;
+static const int NDB_DISCONNECTCONF_GSN= 34;
+static const int NDB_DISCONNECTREF_GSN= 35;
+
+typedef struct ic_ndb_disconnectreq IC_NDB_DISCONNECTREQ;
+struct ic_ndb_disconnectreq
+{
+  guint32 ndb_trans_ref;
+  guint32 my_reference;
+  guint32 my_trans_ref;
+};
+static const int NDB_DISCONNECTREQ_LEN=
+  sizeof(IC_NDB_DISCONNECTREQ)/sizeof(guint32);
+
+/* Commit and abort of a transaction messages */
+static const int NDB_COMMITREQ_GSN= 18;
+static const int NDB_COMMITCONF_GSN= 17;
+static const int NDB_COMMITREF_GSN= 19;
+static const int NDB_ABORTREQ_GSN= 15;
+static const int NDB_ABORTCONF_GSN= 13;
+static const int NDB_ABORTREF_GSN= 14;
+static const int NDB_ABORTREP_GSN= 16;
+
+typedef struct ic_ndb_commitreq IC_NDB_COMMITREQ;
+struct ic_ndb_commitreq
+{
+  guint32 ndb_trans_ref;
+  guint32 transaction_id[2];
+};
+static const int NDB_COMMITREQ_LEN=
+  sizeof(IC_NDB_COMMITREQ)/sizeof(guint32);
+
+typedef struct ic_ndb_abortreq IC_NDB_ABORTREQ;
+struct ic_ndb_abortreq
+{
+  guint32 ndb_trans_ref;
+  guint32 transaction_id[2];
+  guint32 flags;
+};
+static const int NDB_ABORTREQ_LEN=
+  sizeof(IC_NDB_ABORTREQ)/sizeof(guint32);
+
+/*
+  NDB_COMMITCONF, NDB_COMMITREF, NDB_ABORTCONF, NDB_ABORTREF and
+  NDB_ABORTREP all start with our transaction reference and the
+  transaction id, the REF and REP messages follow with an error code.
+*/
+typedef struct ic_ndb_trans_report IC_NDB_TRANS_REPORT;
+struct ic_ndb_trans_report
+{
+  guint32 my_trans_ref;
+  guint32 transaction_id[2];
+};
+static const int NDB_TRANS_REPORT_LEN=
+  sizeof(IC_NDB_TRANS_REPORT)/sizeof(guint32);
+#define IC_TRANS_REPORT_COMMIT_ACK_FLAG (1U << 31)
+
+/* Record data from the NDB kernel */
+static const int RECORD_INFO_GSN= 5;
+
+/* Primary key query messages */
+static const int NDB_PRIM_KEYREQ_GSN= 12;
+static const int NDB_PRIM_KEYCONF_GSN= 10;
+static const int NDB_PRIM_KEYREF_GSN= 11;
+
+typedef struct ic_ndb_prim_keyreq IC_NDB_PRIM_KEYREQ;
+struct ic_ndb_prim_keyreq
+{
+  guint32 ndb_trans_ref;
+  guint32 my_query_ref;
+  guint32 api_version;
+  guint32 table_id;
+  guint32 flags;
+  guint32 schema_version;
+  guint32 transaction_id[2];
+};
+static const int NDB_PRIM_KEYREQ_LEN=
+  sizeof(IC_NDB_PRIM_KEYREQ)/sizeof(guint32);
+
+#define IC_PRIM_KEYREQ_DIRTY_FLAG (1 << 0)
+#define IC_PRIM_KEYREQ_NO_DISK_FLAG (1 << 1)
+#define IC_PRIM_KEYREQ_COMMIT_FLAG (1 << 4)
+#define IC_PRIM_KEYREQ_QUERY_TYPE_SHIFT 5
+#define IC_PRIM_KEYREQ_SIMPLE_FLAG (1 << 8)
+#define IC_PRIM_KEYREQ_EXECUTE_FLAG (1 << 10)
+#define IC_PRIM_KEYREQ_START_FLAG (1 << 11)
+#define IC_PRIM_KEYREQ_INTERPRETED_FLAG (1 << 15)
+
+/* Query types in bit 5-7 of the flags word */
+#define IC_PRIM_KEYREQ_READ 0
+#define IC_PRIM_KEYREQ_UPDATE 1
+#define IC_PRIM_KEYREQ_INSERT 2
+#define IC_PRIM_KEYREQ_DELETE 3
+#define IC_PRIM_KEYREQ_WRITE 4
+#define IC_PRIM_KEYREQ_READ_EXCLUSIVE 5
+
+/*
+  Key information is sent in section 0 and attribute information in
+  section 1 of NDB_PRIM_KEYREQ, so each query is a single message.
+  Each field in the attribute information starts with a header word
+  with the field id in the upper 16 bits and the size of the field data
+  in bytes in the lower 16 bits, the data follows padded to a 4-byte
+  boundary. Reads only send the header word with size 0.
+*/
+#define IC_MAX_KEY_INFO_WORDS 1024
+#define IC_MAX_ATTR_INFO_WORDS 6144
+#define IC_ATTR_HEADER(field_id, size) (((field_id) << 16) + (size))
+
+/*
+  Interpreted programs
+  --------------------
+  Queries with a WHERE condition send an interpreted program that the
+  data node executes on each record before it is read or written. The
+  attribute information then starts with a header of 5 words giving
+  the number of words in each of the sections that follow it:
+  initial read, interpreted program, final update, final read and
+  subroutines. Reads are sent in the final read section and writes in
+  the final update section, these are only performed on records where
+  the program exits with IC_INTERPRETER_EXIT_OK.
+
+  An instruction word has the opcode in bits 0-5 and up to three
+  register numbers in bits 6-8, 9-11 and 12-14. Branch instructions
+  have a forward offset in words from the branch instruction in bits
+  16-31, READ_ATTR_INTO_REG has the field id in bits 16-31. Registers
+  are signed 64-bit values that can also be NULL.
+
+  LOAD_CONST32 is followed by one word and LOAD_CONST64 by two words
+  with the low word first. ATTR_OP_ARG compares a field with a
+  constant using the comparator in bits 12-15, it's followed by a
+  field header word and the constant padded to a 4-byte boundary.
+  BRANCH_ATTR_EQ_NULL is followed by a field header word with size 0.
+  The comparator in register branches is applied as left reg1 and
+  right reg2. A NULL never satisfies a comparison.
+*/
+#define IC_INTERPRETED_HEADER_WORDS 5
+#define IC_MAX_INTERPRETED_WORDS 4096
+#define IC_INTERPRETER_NUM_REGISTERS 8
+
+#define IC_INTERPRETER_READ_ATTR_INTO_REG 1
+#define IC_INTERPRETER_LOAD_CONST_NULL 3
+#define IC_INTERPRETER_LOAD_CONST32 5
+#define IC_INTERPRETER_LOAD_CONST64 6
+#define IC_INTERPRETER_ADD_REG_REG 7
+#define IC_INTERPRETER_SUB_REG_REG 8
+#define IC_INTERPRETER_BRANCH 9
+#define IC_INTERPRETER_BRANCH_REG_EQ_NULL 10
+#define IC_INTERPRETER_BRANCH_EQ_REG_REG 12
+#define IC_INTERPRETER_BRANCH_NE_REG_REG 13
+#define IC_INTERPRETER_BRANCH_LT_REG_REG 14
+#define IC_INTERPRETER_BRANCH_LE_REG_REG 15
+#define IC_INTERPRETER_BRANCH_GT_REG_REG 16
+#define IC_INTERPRETER_BRANCH_GE_REG_REG 17
+#define IC_INTERPRETER_EXIT_OK 18
+#define IC_INTERPRETER_EXIT_REFUSE 19
+#define IC_INTERPRETER_BRANCH_ATTR_OP_ARG 23
+#define IC_INTERPRETER_BRANCH_ATTR_EQ_NULL 24
+#define IC_INTERPRETER_MUL_REG_REG 28
+#define IC_INTERPRETER_DIV_REG_REG 29
+#define IC_INTERPRETER_AND_REG_REG 30
+#define IC_INTERPRETER_OR_REG_REG 31
+#define IC_INTERPRETER_XOR_REG_REG 32
+
+/* Comparators of ATTR_OP_ARG, the first ones are as IC_COMPARATOR_TYPE */
+#define IC_INTERPRETER_COND_LIKE 6
+
+#define IC_INTERPRETER_INSTR(opcode, reg1, reg2, reg3) \
+  ((opcode) + ((reg1) << 6) + ((reg2) << 9) + ((reg3) << 12))
+#define IC_INTERPRETER_BRANCH_OFFSET_SHIFT 16
+#define IC_INTERPRETER_MAX_BRANCH_OFFSET 0xFFFF
+
+typedef struct ic_ndb_prim_keyconf IC_NDB_PRIM_KEYCONF;
+struct ic_ndb_prim_keyconf
+{
+  guint32 my_trans_ref;
+  guint32 gci_high;
+  guint32 flags;
+  guint32 transaction_id[2];
+};
+static const int NDB_PRIM_KEYCONF_LEN=
+  sizeof(IC_NDB_PRIM_KEYCONF)/sizeof(guint32);
+
+#define IC_PRIM_KEYCONF_NUM_QUERIES_MASK 0xFFFF
+#define IC_PRIM_KEYCONF_COMMIT_FLAG (1 << 16)
+#define IC_PRIM_KEYCONF_COMMIT_ACK_FLAG (1 << 17)
+
+typedef struct ic_ndb_prim_keyconf_query IC_NDB_PRIM_KEYCONF_QUERY;
+struct ic_ndb_prim_keyconf_query
+{
+  guint32 my_query_ref;
+  guint32 read_length;
+};
+static const int NDB_PRIM_KEYCONF_QUERY_LEN=
+  sizeof(IC_NDB_PRIM_KEYCONF_QUERY)/sizeof(guint32);
+
+#define IC_PRIM_KEYCONF_READ_LENGTH_MASK 0xFFFF
+
+typedef struct ic_ndb_prim_keyref IC_NDB_PRIM_KEYREF;
+struct ic_ndb_prim_keyref
+{
+  guint32 my_query_ref;
+  guint32 transaction_id[2];
+  guint32 error_code;
+  guint32 not_used;
+};
+static const int NDB_PRIM_KEYREF_LEN=
+  sizeof(IC_NDB_PRIM_KEYREF)/sizeof(guint32);
+
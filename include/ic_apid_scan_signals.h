@@ -13,3 +13,126 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA */
 
+/*
+  Messages used by the scan protocol, the layout of the messages is
+  described together with the code handling them in
+  ic_apid_handle_messages.ic.
+*/
+
+/* Scan messages */
+static const int NDB_SCANREQ_GSN= 45;
+static const int NDB_SCAN_CONTINUE_REQ_GSN= 28;
+static const int NDB_SCANCONF_GSN= 29;
+static const int NDB_SCANREF_GSN= 31;
+
+typedef struct ic_ndb_scanreq IC_NDB_SCANREQ;
+struct ic_ndb_scanreq
+{
+  guint32 ndb_trans_ref;
+  guint32 my_query_ref;
+  guint32 flags;
+  guint32 table_id;
+  guint32 schema_version;
+  guint32 stored_procedure_id;
+  guint32 transaction_id[2];
+  guint32 parent_trans_ref;
+  guint32 batch_byte_size;
+  guint32 first_batch_size;
+};
+static const int NDB_SCANREQ_LEN=
+  sizeof(IC_NDB_SCANREQ)/sizeof(guint32);
+
+#define IC_SCANREQ_PARALLELISM_MASK 0xFF
+#define IC_SCANREQ_LOCK_EXCLUSIVE_FLAG (1 << 8)
+#define IC_SCANREQ_DISK_FLAG (1 << 9)
+#define IC_SCANREQ_HOLD_LOCK_FLAG (1 << 10)
+#define IC_SCANREQ_READ_COMMITTED_FLAG (1 << 11)
+#define IC_SCANREQ_KEY_FLAG (1 << 12)
+#define IC_SCANREQ_RECORD_ORDER_FLAG (1 << 13)
+#define IC_SCANREQ_DESCENDING_FLAG (1 << 14)
+#define IC_SCANREQ_RANGE_FLAG (1 << 15)
+#define IC_SCANREQ_BATCH_SIZE_SHIFT 16
+#define IC_SCANREQ_DISTR_KEY_FLAG (1 << 26)
+#define IC_SCANREQ_MULTI_RANGE_FLAG (1 << 27)
+#define IC_SCANREQ_INTERPRETED_FLAG (1 << 28)
+#define IC_NO_PARENT_TRANS_REF 0xFFFFFFFF
+
+#define IC_MAX_SCAN_PARALLELISM 255
+#define IC_MAX_SCAN_BATCH_SIZE 1023
+#define IC_SCAN_BATCH_BYTE_SIZE 65536
+
+/*
+  Ranges of an ordered index scan are sent in section 2 of NDB_SCANREQ as
+  a list of bounds. Each bound is a bound type word followed by a field
+  header word (index field id and size in bytes) and the bound value
+  padded to a 4-byte boundary, NULL values have size 0. The bound type
+  word of the first bound in each range also contains the range id and
+  the number of words in the range.
+*/
+#define IC_BOUND_LOWER_INCLUSIVE 0
+#define IC_BOUND_LOWER_EXCLUSIVE 1
+#define IC_BOUND_UPPER_INCLUSIVE 2
+#define IC_BOUND_UPPER_EXCLUSIVE 3
+#define IC_BOUND_EQ 4
+#define IC_BOUND_RANGE_ID_SHIFT 4
+#define IC_BOUND_RANGE_LEN_SHIFT 16
+#define IC_MAX_RANGE_ID 0xFFF
+#define IC_MAX_RANGE_INFO_WORDS 8192
+/*
+  Multi-range scans read this pseudo field first in each record, it
+  returns the range id the record was found in.
+*/
+#define IC_RANGE_ID_FIELD_ID 0xFFFB
+
+typedef struct ic_ndb_scan_continue_req IC_NDB_SCAN_CONTINUE_REQ;
+struct ic_ndb_scan_continue_req
+{
+  guint32 ndb_trans_ref;
+  guint32 stop_flag;
+  guint32 transaction_id[2];
+};
+static const int NDB_SCAN_CONTINUE_REQ_LEN=
+  sizeof(IC_NDB_SCAN_CONTINUE_REQ)/sizeof(guint32);
+
+/* More fragment references than this are sent in section 0 */
+#define IC_SCAN_CONTINUE_MAX_INLINE_REFS 21
+
+typedef struct ic_ndb_scanconf IC_NDB_SCANCONF;
+struct ic_ndb_scanconf
+{
+  guint32 my_query_ref;
+  guint32 flags;
+  guint32 transaction_id[2];
+};
+static const int NDB_SCANCONF_LEN=
+  sizeof(IC_NDB_SCANCONF)/sizeof(guint32);
+
+#define IC_SCANCONF_NUM_FRAGMENTS_MASK 0xFF
+#define IC_SCANCONF_END_OF_DATA_FLAG (1 << 8)
+
+/* One entry per fragment with a completed batch follows NDB_SCANCONF */
+typedef struct ic_ndb_scanconf_fragment IC_NDB_SCANCONF_FRAGMENT;
+struct ic_ndb_scanconf_fragment
+{
+  guint32 my_frag_ref;
+  guint32 ndb_frag_ref;
+  guint32 info;
+};
+static const int NDB_SCANCONF_FRAGMENT_LEN=
+  sizeof(IC_NDB_SCANCONF_FRAGMENT)/sizeof(guint32);
+
+#define IC_SCANCONF_NUM_RECORDS_MASK 0x3FF
+#define IC_SCANCONF_NUM_WORDS_SHIFT 10
+/* NDB fragment reference reported when the fragment has been fully scanned */
+#define IC_SCAN_FRAGMENT_CLOSED 0xFFFFFFFF
+
+typedef struct ic_ndb_scanref IC_NDB_SCANREF;
+struct ic_ndb_scanref
+{
+  guint32 my_query_ref;
+  guint32 transaction_id[2];
+  guint32 error_code;
+  guint32 close_needed;
+};
+static const int NDB_SCANREF_LEN=
+  sizeof(IC_NDB_SCANREF)/sizeof(guint32);
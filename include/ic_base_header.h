@@ -27,6 +27,13 @@
 
 /* Configure definitions are needed also in header files */
 #include <config.h>
+/*
+  A production build never carries the debug system, not even the
+  entry/return bookkeeping, since it is executed for every message.
+*/
+#if defined(WITH_PRODUCTION) && defined(DEBUG_BUILD)
+#undef DEBUG_BUILD
+#endif
 
 #ifdef WINDOWS
 #define _WIN32_WINNT 0x0601
@@ -94,6 +101,7 @@ typedef struct ic_dynamic_array IC_DYNAMIC_ARRAY;
 typedef struct ic_hashtable IC_HASHTABLE;
 typedef struct ic_hash_entry IC_HASH_ENTRY;
 typedef struct ic_hashtable_itr IC_HASHTABLE_ITR;
+typedef struct ic_oa_hashtable IC_OA_HASHTABLE;
 typedef struct ic_memory_container IC_MEMORY_CONTAINER;
 typedef struct ic_poll_set IC_POLL_SET;
 typedef struct ic_sock_buf_page IC_SOCK_BUF_PAGE;
@@ -123,7 +123,8 @@ struct ic_connect_operations
                                         guint32 tcp_send_buffer_size);
   /*
     Use this to set the socket to nonblocking mode, inherited to a forked
-    socket after successful accept.
+    socket after successful accept. An already connected socket is set to
+    nonblocking mode immediately.
   */
   void (*ic_set_nonblocking)           (IC_CONNECTION *conn);
   /* Set/Get timeout in millisecs used by ic_check_for_data, default 10 secs */
@@ -155,6 +156,8 @@ struct ic_connect_operations
     There is support for memory buffering in front of the socket.
     In this case it is necessary to flush the memory buffer in order
     to ensure that buffered operations have actually been written.
+    A read on a nonblocking socket without data returns EWOULDBLOCK,
+    writes wait for room in the socket buffer up to secs_to_try seconds.
   */
   int (*ic_read_connection)            (IC_CONNECTION *conn,
                                         void *buf,
@@ -170,6 +173,19 @@ struct ic_connect_operations
                                         guint32 tot_size,
                                         guint32 secs_to_try);
   int (*ic_flush_connection)           (IC_CONNECTION *conn);
+  /*
+    Reads and writes done on the socket outside of the connection object,
+    e.g. asynchronously through a poll set, are added to the statistics
+    of the connection with these calls. An error of 0 counts a buffer of
+    the given size, EINTR counts a send timeout and other errors count
+    as read or send errors.
+  */
+  void (*ic_add_read_stat)             (IC_CONNECTION *conn,
+                                        guint32 size,
+                                        int error);
+  void (*ic_add_write_stat)            (IC_CONNECTION *conn,
+                                        guint32 size,
+                                        int error);
   /*
     After bind or connect it is possible to get port number when using
     ephemeral ports
@@ -29,6 +29,21 @@ extern guint32 glob_debug_screen;
 extern guint32 glob_debug_timestamp;
 
 #define IC_DEBUG_MAX_INDENT_LEVEL 128
+/*
+  The trace ring records events in binary form in the hot path, it is
+  only formatted when dumped. It's dumped at thread exit and by a thread
+  that discovers a node failure. The size must be a power of 2.
+*/
+#define IC_DEBUG_TRACE_SIZE 1024
+struct ic_debug_trace_entry
+{
+  guint64 timestamp;
+  guint32 event;
+  guint32 data1;
+  guint32 data2;
+};
+typedef struct ic_debug_trace_entry IC_DEBUG_TRACE_ENTRY;
+
 struct ic_thread_debug
 {
   guint32 thread_id;
@@ -36,7 +51,9 @@ struct ic_thread_debug
   guint32 enabled;
   guint32 save_enabled;
   guint32 disable_count;
+  guint32 trace_index;
   const gchar *entry_point[IC_DEBUG_MAX_INDENT_LEVEL];
+  IC_DEBUG_TRACE_ENTRY trace[IC_DEBUG_TRACE_SIZE];
 };
 typedef struct ic_thread_debug IC_THREAD_DEBUG;
 
@@ -73,6 +90,7 @@ int ic_setup_stdout(gchar *log_file);
 #define HEARTBEAT_LEVEL 16384
 #define COMM_DETAIL_LEVEL 32768
 #define FIND_NODE_CONFIG_LEVEL 65536
+#define TRACE_LEVEL 131072
 #define ALL_DEBUG_LEVELS 0xFFFFFFFF
 
 #ifdef DEBUG_BUILD
@@ -91,6 +109,8 @@ void ic_debug_close();
 gboolean ic_is_debug_system_active();
 void ic_debug_disable(guint32 level);
 void ic_debug_enable(guint32 level);
+void ic_debug_trace(guint32 event, guint32 data1, guint32 data2);
+void ic_debug_trace_dump();
 
 #define INT_DEBUG_RETURN_TYPE (int)0
 #define PTR_DEBUG_RETURN_TYPE (int)1
@@ -156,6 +176,11 @@ void ic_debug_enable(guint32 level);
     ic_debug_print_rec_buf((a)->str, (a)->len)
 #define DEBUG_DISABLE(level) ic_debug_disable(((guint32)(level)))
 #define DEBUG_ENABLE(level) ic_debug_enable(((guint32)(level)))
+#define DEBUG_TRACE(event, data1, data2) \
+  { if (ic_get_debug() & TRACE_LEVEL) \
+      ic_debug_trace((guint32)(event), (guint32)(data1), (guint32)(data2)); }
+#define DEBUG_TRACE_DUMP \
+  { if (ic_get_debug() & TRACE_LEVEL) ic_debug_trace_dump(); }
 #else
 #define DEBUG_THREAD_RETURN return NULL
 #define DEBUG_RETURN_EMPTY return
@@ -174,5 +199,8 @@ void ic_debug_enable(guint32 level);
 #define DEBUG_IC_STRING(level, a)
 #define DEBUG_DISABLE(level)
 #define DEBUG_ENABLE(level)
+#define DEBUG_TRACE(event, data1, data2)
+#define DEBUG_TRACE_DUMP
+#define ic_is_debug_system_active() FALSE
 #endif
 #endif
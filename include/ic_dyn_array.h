@@ -49,6 +49,10 @@ typedef struct ic_dynamic_ptr_array IC_DYNAMIC_PTR_ARRAY;
 /*
   First index will be 1 and it will continue to increase as long as there is
   only ic_insert_ptr calls made and no ic_remove_ptr calls.
+
+  All methods except ic_free_dynamic_ptr_array can be called concurrently
+  from several threads, no locks are used and ic_get_ptr is a constant
+  time lookup.
 */
 struct ic_dynamic_ptr_array_ops
 {
@@ -19,7 +19,7 @@
 #include <errno.h>
 
 #define IC_FIRST_ERROR 7000
-#define IC_LAST_ERROR 7123
+#define IC_LAST_ERROR 7133
 #define IC_MAX_ERRORS 200
 
 /*
@@ -183,5 +183,15 @@ typedef struct ic_config_error IC_CONFIG_ERROR;
 #define IC_ERROR_NO_CONF_ENTRY_FOUND 7121
 #define IC_ERROR_NO_DEF_NODE_SECT_FOUND 7122
 #define IC_ERROR_NO_SUCH_NODE_TYPE 7123
+#define IC_ERROR_KEY_NOT_DEFINED 7124
+#define IC_ERROR_KEY_QUERY_TOO_BIG 7125
+#define IC_ERROR_ILLEGAL_SCAN_PARAMETER 7126
+#define IC_ERROR_ILLEGAL_RANGE_DEFINITION 7127
+#define IC_ERROR_RANGE_TOO_BIG 7128
+#define IC_ERROR_ILLEGAL_WHERE_CONDITION 7129
+#define IC_ERROR_WHERE_CONDITION_TOO_BIG 7130
+#define IC_ERROR_WHERE_CONDITION_NOT_PUSHABLE 7131
+#define IC_ERROR_TRANSACTION_NOT_ACTIVE 7132
+#define IC_ERROR_WHERE_CONDITION_NOT_SATISFIED 7133
 
 #endif
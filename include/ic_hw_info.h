@@ -45,4 +45,8 @@ void ic_get_mem_info(guint32 *num_numa_nodes,
 
 void ic_get_disk_info(gchar *directory_name,
                       guint32 *disk_space);
+
+/* Interfaces to place threads on CPUs */
+int ic_bind_thread_to_cpus(guint32 *cpu_ids, guint32 num_cpus);
+guint32 ic_get_current_cpu();
 #endif
@@ -17,6 +17,7 @@
   if ((parent_object)->first_##name) \
   { \
     (parent_object)->last_##name->next_##name = (object); \
+    (parent_object)->last_##name = (object); \
   } \
   else \
   { \
@@ -76,6 +77,7 @@
     { \
       ic_assert((parent_object)->first_##name == (object)); \
       (parent_object)->first_##name = (object)->next_##name; \
+      (object)->next_##name->prev_##name = NULL; \
     } \
   } \
   else /* We are the last object */ \
@@ -107,5 +109,5 @@
 #define FOR_EACH_DLL(variable, object, field) \
   for ((variable)= IC_GET_FIRST_DLL(object, field); \
        (variable); \
-       (variable)= IC_GET_NEXT_DLL(variable), field))
+       (variable)= IC_GET_NEXT_DLL((variable), field))
 
@@ -22,6 +22,14 @@
   Reset means that we deallocate everything one container of base size.
   Thus we're back to the situation after performing the first allocation of
   the container. Reset will also set all bytes to 0 in container.
+
+  A thread memory container is owned by one thread and never uses a mutex.
+  Reset only rewinds the container, the buffers of base size are kept and
+  reused by later allocations and no memory is set to 0, only
+  ic_mc_calloc sets the allocated memory to 0. Thus allocations after a
+  reset are only a pointer increment until more memory is used than before
+  the reset. Memory is only returned when the container is freed, except
+  for allocations larger than base size that are released at reset.
 */
 #ifndef IC_MC_H
 #define IC_MC_H
@@ -46,4 +54,8 @@ IC_MEMORY_CONTAINER*
 ic_create_memory_container(guint32 base_size,
                            guint32 max_size,
                            gboolean use_mutex);
+
+IC_MEMORY_CONTAINER*
+ic_create_thread_memory_container(guint32 base_size,
+                                  guint32 max_size);
 #endif
@@ -0,0 +1,74 @@
+/* Copyright (C) 2026 iClaustron AB
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA */
+
+#ifndef IC_OA_HASHTABLE_H
+#define IC_OA_HASHTABLE_H
+
+#include <ic_base_header.h>
+#include <ic_hashtable.h>
+
+/*
+  Open addressing hash table with the same interface as IC_HASHTABLE and
+  using the same hash and key equality functions (ic_hash_str,
+  ic_keys_equal_str and so forth).
+
+  The table uses Robin Hood hashing, entries are stored in the table
+  itself, so no memory is allocated per insert and a search reads
+  consecutive slots. Each slot has a control byte with its distance from
+  the home slot of its key, the control bytes are kept in a separate
+  cache line aligned array such that a search mostly scans control bytes.
+
+  When the table is grown the entries are moved to the new table a few
+  slots at a time on each insert and remove, so no single call rehashes
+  the entire table.
+
+  There is no iterator on the table, use IC_HASHTABLE when the entries
+  need to be scanned.
+*/
+
+/*
+  ic_create_oa_hashtable
+    Create a table able to hold at least minsize entries without growing.
+    Returns NULL on memory allocation failure.
+
+  ic_oa_hashtable_insert
+    Insert value with key, the table doesn't copy the key, it must stay
+    valid until it's removed from the table. Returns 0 on success and
+    IC_ERROR_MEM_ALLOC otherwise. Duplicate keys are not checked for, as
+    for IC_HASHTABLE it's undefined which value a search then returns.
+
+  ic_oa_hashtable_search
+    Returns the value inserted with the key or NULL if not found.
+
+  ic_oa_hashtable_remove
+    Remove the key and return its value, NULL if not found.
+
+  ic_oa_hashtable_count
+    Returns the number of entries in the table.
+
+  ic_oa_hashtable_destroy
+    Free the table, the keys and values aren't freed.
+*/
+IC_OA_HASHTABLE*
+ic_create_oa_hashtable(guint32 minsize,
+                       unsigned int (*hash_fn) (void*),
+                       int (*key_eq_fn) (void*, void*));
+
+int ic_oa_hashtable_insert(IC_OA_HASHTABLE *h, void *key, void *value);
+void* ic_oa_hashtable_search(IC_OA_HASHTABLE *h, void *key);
+void* ic_oa_hashtable_remove(IC_OA_HASHTABLE *h, void *key);
+guint32 ic_oa_hashtable_count(IC_OA_HASHTABLE *h);
+void ic_oa_hashtable_destroy(IC_OA_HASHTABLE *h);
+#endif
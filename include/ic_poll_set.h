@@ -21,9 +21,28 @@ struct ic_poll_connection
   guint32 index;
   void *user_obj;
   int ret_code;
+  /* Connection is in the ready list or the pending list of the poll set */
+  gboolean is_ready;
 };
 typedef struct ic_poll_connection IC_POLL_CONNECTION;
 
+struct ic_poll_write
+{
+  void *user_obj;
+  guint32 bytes_written;
+  int ret_code;
+};
+typedef struct ic_poll_write IC_POLL_WRITE;
+
+struct ic_poll_read
+{
+  void *user_obj;
+  guint32 buf_id;
+  guint32 bytes_read;
+  int ret_code;
+};
+typedef struct ic_poll_read IC_POLL_READ;
+
 struct ic_poll_operations
 {
   /*
@@ -59,9 +78,60 @@ struct ic_poll_operations
     implementation so requires close any file descriptor of the poll
     set.
 
+    A connection is reported as ready when new data arrives on it, the
+    epoll and kqueue implementations are edge-triggered. Thus the user
+    must read from a reported socket until the read would block or until
+    it gets less data than it asked for. If the user stops reading
+    before that, e.g. to be fair to other sockets, it must call
+    ic_poll_set_still_ready before calling ic_get_next_connection again.
+    The connection last returned by ic_get_next_connection is then
+    reported as ready by the next ic_check_poll_set without waiting for
+    new data. A connection is never reported twice in one check.
+
     ic_is_poll_set_full can be used to check if there is room for more
-    socket connections in the poll set. The poll set has a limited size
+    socket connections in the poll set. The poll set grows as connections
+    are added, only the io_uring implementation has a limited size
     (currently set to 1024) set by a compile time parameter.
+
+    Some implementations (io_uring) can also perform writes on the sockets
+    asynchronously, ic_poll_set_has_async_write reports whether this is
+    supported. ic_poll_set_async_writev starts a write of the buffers in
+    the write vector on the socket, the buffers must stay untouched until
+    the write has completed, the write vector itself is copied. The
+    completion is reported by ic_check_poll_set and retrieved through
+    ic_get_next_write in the same manner as ic_get_next_connection. The
+    IC_POLL_WRITE object contains the user object, the number of bytes
+    written which can be less than requested and an error code. It is
+    only valid until the next call to ic_poll_set_async_writev.
+
+    ic_poll_set_register_write_buffers registers memory areas that writes
+    are made from, it can only be called once. Writes of a single buffer
+    within the registered areas avoid mapping the pages in the kernel for
+    each write, other writes work as before. Such writes can raise SIGPIPE,
+    registration is thus refused unless the application ignores SIGPIPE,
+    e.g. through ic_set_sig_error_handler. An error is returned if the
+    areas couldn't be registered, writes still work in this case.
+    ic_poll_set_cancel_write cancels an ongoing write of the user object,
+    the write is still reported by ic_get_next_write, with an error if it
+    didn't complete before it was cancelled.
+
+    The io_uring implementation can also read from the sockets itself,
+    ic_poll_set_has_async_read reports whether this is supported. The user
+    hands buffers to the poll set with ic_poll_set_provide_read_buffer,
+    all buffers must have the same size and the first buffer must be
+    provided before any connection is added. The poll set then reads
+    data into one of the buffers as soon as it arrives on a connection
+    instead of reporting the connection as ready. ic_get_next_read returns
+    the completed reads after ic_check_poll_set in the order they
+    completed, it returns NULL when all have been returned. The
+    IC_POLL_READ object contains the user object of the connection, the
+    id of the buffer read into and the number of bytes read. The buffer
+    belongs to the user until provided again. If ret_code is set the read
+    failed, no buffer was used and the connection isn't read from again,
+    IC_END_OF_FILE is reported when the other end closed the connection.
+    The object is only valid until the next call to ic_check_poll_set. Data
+    read before a connection is removed is still reported by
+    ic_get_next_read after the removal.
   */
   int (*ic_poll_set_add_connection)    (IC_POLL_SET *poll_set,
                                         int fd,
@@ -72,8 +142,29 @@ struct ic_poll_operations
                                         int ms_time);
   const IC_POLL_CONNECTION*
       (*ic_get_next_connection)        (IC_POLL_SET *poll_set);
+  void (*ic_poll_set_still_ready)      (IC_POLL_SET *poll_set);
   void (*ic_free_poll_set)             (IC_POLL_SET *poll_set);
   gboolean (*ic_is_poll_set_full)      (IC_POLL_SET *poll_set);
+  gboolean (*ic_poll_set_has_async_write) (IC_POLL_SET *poll_set);
+  int (*ic_poll_set_async_writev)      (IC_POLL_SET *poll_set,
+                                        int fd,
+                                        IC_IOVEC *write_vector,
+                                        guint32 iovec_size,
+                                        void *user_obj);
+  const IC_POLL_WRITE*
+      (*ic_get_next_write)             (IC_POLL_SET *poll_set);
+  int (*ic_poll_set_register_write_buffers) (IC_POLL_SET *poll_set,
+                                             IC_IOVEC *buffers,
+                                             guint32 num_buffers);
+  int (*ic_poll_set_cancel_write)      (IC_POLL_SET *poll_set,
+                                        void *user_obj);
+  gboolean (*ic_poll_set_has_async_read) (IC_POLL_SET *poll_set);
+  int (*ic_poll_set_provide_read_buffer) (IC_POLL_SET *poll_set,
+                                          gchar *buf,
+                                          guint32 buf_size,
+                                          guint32 buf_id);
+  const IC_POLL_READ*
+      (*ic_get_next_read)              (IC_POLL_SET *poll_set);
 };
 typedef struct ic_poll_operations IC_POLL_OPERATIONS;
 
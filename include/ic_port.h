@@ -131,6 +131,18 @@ IC_TIMER ic_millis_elapsed(IC_TIMER start_time, IC_TIMER end_time);
 void ic_sleep_low(guint32 seconds_to_sleep);
 void ic_microsleep(guint32 microseconds_to_sleep);
 
+/*
+  Hint to the CPU that we're in a busy wait loop, this saves power and
+  gives the other CPU thread of the core more resources.
+*/
+#if defined(__i386__) || defined(__x86_64__)
+#define ic_cpu_pause() __asm__ __volatile__("pause")
+#elif defined(__aarch64__)
+#define ic_cpu_pause() __asm__ __volatile__("yield")
+#else
+#define ic_cpu_pause()
+#endif
+
 /**
  * Interfaces to daemonize a program
  * ---------------------------------
@@ -185,6 +197,17 @@ void ic_controlled_terminate();
 }
 guint32 ic_byte_order();
 
+/*
+  Operations on arrays of 32-bit words used by the NDB Protocol to handle
+  checksums and byte order of messages. ic_xor_words returns the XOR of all
+  words and ic_swap_endian_words swaps the byte order of all words in place.
+  The words need not be aligned beyond 4 bytes. These are function pointers
+  set by ic_port_init to the fastest implementation supported by the CPU
+  (AVX2, SSE2 or plain C).
+*/
+extern guint32 (*ic_xor_words)(const guint32 *words, guint32 num_words);
+extern void (*ic_swap_endian_words)(guint32 *words, guint32 num_words);
+
 #define IC_MUTEX GMutex
 #define IC_COND GCond
 #define IC_SPINLOCK GMutex
@@ -198,6 +221,7 @@ void ic_cond_destroy(IC_COND **cond);
 
 void ic_mutex_lock(IC_MUTEX *mutex);
 void ic_mutex_lock_low(IC_MUTEX *mutex);
+gboolean ic_mutex_trylock(IC_MUTEX *mutex);
 void ic_mutex_unlock(IC_MUTEX *mutex);
 void ic_mutex_unlock_low(IC_MUTEX *mutex);
 IC_MUTEX* ic_mutex_create();
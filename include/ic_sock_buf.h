@@ -21,6 +21,17 @@
 #define PRIO_LEVELS 2
 #define MAX_ALLOC_SEGMENTS 8
 #define HIGH_PRIO_BUF_SIZE 128
+/*
+  Each thread keeps a small cache of free pages per socket buffer pool.
+  The cache is refilled from the global free list and drained back to it
+  in batches of half the cache size. Pools are registered in a small
+  global array, pools created when the array is full don't use any
+  thread cache. The cache size is limited by the pool size such that a
+  few threads can't hoard all pages of a small pool.
+*/
+#define IC_MAX_SOCK_BUF_POOLS 16
+#define IC_SOCK_BUF_MAX_CACHE_SIZE 64
+#define IC_SOCK_BUF_CACHE_DIVISOR 64
 typedef struct ic_sock_buf_operations IC_SOCK_BUF_OPERATIONS;
 typedef struct ic_sock_buf IC_SOCK_BUF;
 
@@ -36,6 +47,10 @@ struct ic_sock_buf_operations
     Thus if num_pages is 10, this routine will use the local free_pages
     free list 90% of the time and every 10th time the function is called
     it will allocate 10 socket buffer pages from the global free list.
+
+    When no local free list is provided the page is taken from the thread
+    cache of the calling thread, this cache is refilled in batches from
+    the global free list.
   */
   IC_SOCK_BUF_PAGE* (*ic_get_sock_buf_page)
       (IC_SOCK_BUF *buf,
@@ -56,10 +71,12 @@ struct ic_sock_buf_operations
        guint32 milliseconds_to_wait);
 
   /*
-    This routine is used return socket buffer pages to the global free list.
+    This routine is used return socket buffer pages to the free list.
     It will treat the pointer to the first socket buffer page as the first
     page in a linked list of pages. Thus more than one page at a time can
-    be returned to the global free list.
+    be returned to the free list. The pages are put in the thread cache of
+    the calling thread, when the cache is full half of it is returned to
+    the global free list.
   */
   void (*ic_return_sock_buf_page) (IC_SOCK_BUF *buf,
                                    IC_SOCK_BUF_PAGE *page);
@@ -70,6 +87,22 @@ struct ic_sock_buf_operations
     pages. This is done in increments rather than reallocating everything.
   */
   int (*ic_inc_sock_buf) (IC_SOCK_BUF *buf, guint64 no_of_pages);
+  /*
+    Pages returned by a thread are kept in a thread local cache, this
+    routine returns all pages in the cache of the calling thread to the
+    global free list. It is called automatically when a thread exits, it
+    can also be called by a thread that goes idle for a long time.
+  */
+  void (*ic_release_thread_cache) (IC_SOCK_BUF *buf);
+  /*
+    This routine fills in the memory areas holding the buffers of the
+    pages, one area per allocation, and returns the number of areas. It's
+    used to register the buffers with the kernel. Areas allocated later
+    by ic_inc_sock_buf aren't part of a registration done before.
+  */
+  guint32 (*ic_get_buffer_areas) (IC_SOCK_BUF *buf,
+                                  IC_IOVEC *areas,
+                                  guint32 max_areas);
   /*
     This routine frees all socket buffer pages allocated to this global pool.
   */
@@ -101,7 +134,14 @@ struct ic_sock_buf
   guint32 page_size;
   guint32 alloc_segments;
   gchar *alloc_segments_ref[MAX_ALLOC_SEGMENTS];
+  guint64 alloc_segments_pages[MAX_ALLOC_SEGMENTS];
   IC_MUTEX *ic_buf_mutex;
+  /* Index in global pool array, IC_MAX_SOCK_BUF_POOLS means no cache */
+  guint32 pool_id;
+  /* Max number of pages in a thread cache, 0 means no thread cache */
+  guint32 cache_size;
+  /* Unique id of pool, used to discover caches of already freed pools */
+  guint64 pool_instance;
 };
 
 /*
@@ -131,4 +171,22 @@ struct ic_sock_buf
 IC_SOCK_BUF*
 ic_create_sock_buf(guint32 page_size,
                    guint64 no_of_pages);
+
+/*
+  Create a socket buffer pool where all memory is written by the calling
+  thread before returning. With the first touch policy of the OS the
+  memory of the pool is thus placed on the NUMA node of the CPU the
+  calling thread executes on.
+*/
+IC_SOCK_BUF*
+ic_create_local_sock_buf(guint32 page_size,
+                         guint64 no_of_pages);
+
+/*
+  Return the pages in the caches of the calling thread in all pools to
+  the global free lists. A thread returns pages to many pools, so this is
+  called by threads before they stop, the pages then don't have to wait
+  for the thread local storage to be released at thread exit.
+*/
+void ic_release_all_thread_caches();
 #endif
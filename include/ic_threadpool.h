@@ -181,6 +181,22 @@ struct ic_threadpool_ops
 
   /* Stop threadpool and release all its resources */
   void (*ic_threadpool_stop) (IC_THREADPOOL_STATE *tp_state);
+
+  /*
+    Set CPUs of threads in the pool
+    -------------------------------
+    Description: Threads started in the pool after this call bind
+    themselves to the given CPUs in ic_thread_started. With dedicated_cpus
+    each thread is bound to one of the CPUs, the CPUs are handed out round
+    robin in the order given. Otherwise each thread can execute on any of
+    the CPUs. Setting num_cpus to 0 removes the binding. The processor ids
+    are the ones reported by ic_get_cpu_info. Failure to bind a thread
+    isn't reported, the thread executes without binding in this case.
+  */
+  int (*ic_threadpool_set_cpus) (IC_THREADPOOL_STATE *tp_state,
+                                 guint32 *cpu_ids,
+                                 guint32 num_cpus,
+                                 gboolean dedicated_cpus);
 };
 typedef struct ic_threadpool_ops IC_THREADPOOL_OPS;
 
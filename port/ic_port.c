@@ -87,6 +87,9 @@ static const gchar *port_config_dir;
 static guint32 volatile ic_stop_flag= 0;
 static guint32 ic_port_inited= 0;
 
+/* Select implementation of word operations on NDB messages */
+static void init_word_operations();
+
 #ifdef WINDOWS
 IC_POLL_FUNCTION ic_poll;
 #endif
@@ -186,6 +189,7 @@ static IC_MUTEX *mem_entry_hash_mutex= NULL;
 void
 ic_port_init()
 {
+  init_word_operations();
   ic_require(exec_output_mutex= ic_mutex_create());
 #ifdef DEBUG_BUILD
   ic_require(mem_mutex= ic_mutex_create());
@@ -1813,6 +1817,133 @@ guint32 ic_byte_order()
   }
 }
 
+/*
+  Word operations on NDB messages. The SIMD variants are compiled with
+  target attributes such that the rest of the code doesn't require any
+  special compiler flags, the implementation is chosen at run time based
+  on what the CPU supports.
+*/
+static guint32
+scalar_xor_words(const guint32 *words, guint32 num_words)
+{
+  guint32 i, result= 0;
+
+  for (i= 0; i < num_words; i++)
+    result^= words[i];
+  return result;
+}
+
+static void
+scalar_swap_endian_words(guint32 *words, guint32 num_words)
+{
+  guint32 i;
+
+  for (i= 0; i < num_words; i++)
+    words[i]= GUINT32_SWAP_LE_BE(words[i]);
+}
+
+guint32 (*ic_xor_words)(const guint32 *words, guint32 num_words)=
+  scalar_xor_words;
+void (*ic_swap_endian_words)(guint32 *words, guint32 num_words)=
+  scalar_swap_endian_words;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IC_USE_X86_SIMD
+#include <immintrin.h>
+
+__attribute__((target("sse2")))
+static guint32
+sse2_xor_words(const guint32 *words, guint32 num_words)
+{
+  guint32 i= 0, result;
+  __m128i acc= _mm_setzero_si128();
+  guint32 lanes[4];
+
+  for (; i + 4 <= num_words; i+= 4)
+    acc= _mm_xor_si128(acc, _mm_loadu_si128((const __m128i*)&words[i]));
+  _mm_storeu_si128((__m128i*)lanes, acc);
+  result= lanes[0] ^ lanes[1] ^ lanes[2] ^ lanes[3];
+  return result ^ scalar_xor_words(&words[i], num_words - i);
+}
+
+__attribute__((target("sse2")))
+static void
+sse2_swap_endian_words(guint32 *words, guint32 num_words)
+{
+  guint32 i= 0;
+  __m128i word_vec;
+
+  for (; i + 4 <= num_words; i+= 4)
+  {
+    word_vec= _mm_loadu_si128((const __m128i*)&words[i]);
+    /* Swap bytes in each 16-bit half, then swap the 16-bit halves */
+    word_vec= _mm_or_si128(_mm_slli_epi16(word_vec, 8),
+                           _mm_srli_epi16(word_vec, 8));
+    word_vec= _mm_shufflelo_epi16(word_vec, _MM_SHUFFLE(2, 3, 0, 1));
+    word_vec= _mm_shufflehi_epi16(word_vec, _MM_SHUFFLE(2, 3, 0, 1));
+    _mm_storeu_si128((__m128i*)&words[i], word_vec);
+  }
+  scalar_swap_endian_words(&words[i], num_words - i);
+}
+
+__attribute__((target("avx2")))
+static guint32
+avx2_xor_words(const guint32 *words, guint32 num_words)
+{
+  guint32 i= 0;
+  __m256i acc= _mm256_setzero_si256();
+  __m128i acc128;
+  guint32 lanes[4];
+
+  for (; i + 8 <= num_words; i+= 8)
+    acc= _mm256_xor_si256(acc,
+                          _mm256_loadu_si256((const __m256i*)&words[i]));
+  acc128= _mm_xor_si128(_mm256_castsi256_si128(acc),
+                        _mm256_extracti128_si256(acc, 1));
+  _mm_storeu_si128((__m128i*)lanes, acc128);
+  return lanes[0] ^ lanes[1] ^ lanes[2] ^ lanes[3] ^
+         scalar_xor_words(&words[i], num_words - i);
+}
+
+__attribute__((target("avx2")))
+static void
+avx2_swap_endian_words(guint32 *words, guint32 num_words)
+{
+  guint32 i= 0;
+  const __m256i swap_mask= _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11,
+                                           4, 5, 6, 7, 0, 1, 2, 3,
+                                           12, 13, 14, 15, 8, 9, 10, 11,
+                                           4, 5, 6, 7, 0, 1, 2, 3);
+  __m256i word_vec;
+
+  for (; i + 8 <= num_words; i+= 8)
+  {
+    word_vec= _mm256_loadu_si256((const __m256i*)&words[i]);
+    word_vec= _mm256_shuffle_epi8(word_vec, swap_mask);
+    _mm256_storeu_si256((__m256i*)&words[i], word_vec);
+  }
+  scalar_swap_endian_words(&words[i], num_words - i);
+}
+#endif
+
+static void
+init_word_operations()
+{
+#ifdef IC_USE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    ic_xor_words= avx2_xor_words;
+    ic_swap_endian_words= avx2_swap_endian_words;
+  }
+  else if (__builtin_cpu_supports("sse2"))
+  {
+    ic_xor_words= sse2_xor_words;
+    ic_swap_endian_words= sse2_swap_endian_words;
+  }
+#endif
+}
+
 #ifdef DEBUG_BUILD
 static void debug_lock_mutex(IC_MUTEX *mutex)
 {
@@ -1923,6 +2054,17 @@ void ic_mutex_lock_low(IC_MUTEX *mutex)
   g_mutex_lock(mutex);
 }
 
+/* Returns TRUE if the mutex was acquired without waiting */
+gboolean ic_mutex_trylock(IC_MUTEX *mutex)
+{
+  if (!g_mutex_trylock(mutex))
+    return FALSE;
+#ifdef DEBUG_BUILD
+  debug_lock_mutex(mutex);
+#endif
+  return TRUE;
+}
+
 void ic_mutex_unlock(IC_MUTEX *mutex)
 {
   g_mutex_unlock(mutex);
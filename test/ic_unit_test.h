@@ -0,0 +1,38 @@
+/* Copyright (C) 2014 iClaustron AB
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA */
+
+/*
+  Unit tests of module internals, the tests are compiled into the
+  modules when built WITH_UNIT_TEST and run by test_unit. They aren't
+  part of any public interface.
+*/
+#ifndef IC_UNIT_TEST_H
+#define IC_UNIT_TEST_H
+
+#ifdef WITH_UNIT_TEST
+/* Unit test of the thread memory container internals */
+int ic_unit_test_thread_mc(void);
+
+/* Unit tests of the Data API internals */
+int ic_unit_test_apid_trans(void);
+int ic_unit_test_apid_key_hash(void);
+int ic_unit_test_apid_where(void);
+int ic_unit_test_apid_where_eval(void);
+int ic_unit_test_apid_table_cache(void);
+int ic_unit_test_apid_record_info(void);
+int ic_unit_test_apid_packed_message(void);
+int ic_unit_test_apid_scan(void);
+#endif
+#endif
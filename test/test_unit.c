@@ -24,8 +24,17 @@
 #include <ic_apic.h>
 #include <ic_bitmap.h>
 #include <ic_hashtable.h>
+#include <ic_oa_hashtable.h>
 #include <ic_parse_connectstring.h>
 #include <ic_sock_buf.h>
+#include <ic_threadpool.h>
+#include <ic_poll_set.h>
+#include <ic_apid.h>
+#include "ic_unit_test.h"
+/* System header files */
+#include <unistd.h>
+#include <sys/socket.h>
+#include <signal.h>
 
 static int glob_test_type= 0;
 static GOptionEntry entries[] = 
@@ -338,6 +347,156 @@ error:
   return ret_code;
 }
 
+#define DYN_PTR_TEST_THREADS 8
+#define DYN_PTR_TEST_HELD 128
+#define DYN_PTR_TEST_LOOPS 20000
+
+struct ic_test_dyn_ptr_thread
+{
+  IC_DYNAMIC_PTR_ARRAY *dyn_ptr;
+  guint64 objects[DYN_PTR_TEST_HELD];
+  guint64 index[DYN_PTR_TEST_HELD];
+  int ret_code;
+};
+typedef struct ic_test_dyn_ptr_thread IC_TEST_DYN_PTR_THREAD;
+
+/*
+  Each thread inserts, looks up and removes its own objects in random
+  order while looking up random indexes used by the other threads. An
+  entry must always contain the object inserted into it until the object
+  is removed.
+*/
+static gpointer
+run_dyn_ptr_thread(gpointer data)
+{
+  IC_THREAD_STATE *thread_state= (IC_THREAD_STATE*)data;
+  IC_THREADPOOL_STATE *tp_state= thread_state->ic_get_threadpool(thread_state);
+  IC_TEST_DYN_PTR_THREAD *test_thread= (IC_TEST_DYN_PTR_THREAD*)
+    tp_state->ts_ops.ic_thread_get_object(thread_state);
+  IC_DYNAMIC_PTR_ARRAY *dyn_ptr= test_thread->dyn_ptr;
+  void *ret_object;
+  guint64 max_index;
+  guint32 i, j;
+  int ret_code;
+  GRand *random;
+  DEBUG_THREAD_ENTRY("run_dyn_ptr_thread");
+
+  random= g_rand_new();
+  tp_state->ts_ops.ic_thread_started(thread_state);
+  for (i= 0; i < DYN_PTR_TEST_LOOPS; i++)
+  {
+    j= (guint32)g_rand_int_range(random, 0, DYN_PTR_TEST_HELD);
+    if (test_thread->index[j] == 0)
+    {
+      if (dyn_ptr->dpa_ops.ic_insert_ptr(dyn_ptr,
+                                         &test_thread->index[j],
+                                         (void*)&test_thread->objects[j]) ||
+          test_thread->index[j] == 0)
+        test_thread->ret_code= 1;
+    }
+    else if (g_rand_int_range(random, 0, 2) == 0)
+    {
+      if (dyn_ptr->dpa_ops.ic_get_ptr(dyn_ptr,
+                                      test_thread->index[j],
+                                      &ret_object) ||
+          ret_object != (void*)&test_thread->objects[j])
+        test_thread->ret_code= 1;
+    }
+    else
+    {
+      if (dyn_ptr->dpa_ops.ic_remove_ptr(dyn_ptr,
+                                         test_thread->index[j],
+                                         (void*)&test_thread->objects[j]))
+        test_thread->ret_code= 1;
+      test_thread->index[j]= 0;
+    }
+    /* Other threads change the entries, only the result code is checked */
+    max_index= dyn_ptr->dpa_ops.ic_get_max_index(dyn_ptr);
+    ret_code= dyn_ptr->dpa_ops.ic_get_ptr(dyn_ptr,
+                  (guint64)g_rand_int_range(random, 0, (gint32)max_index),
+                  &ret_object);
+    if (ret_code && ret_code != IC_ERROR_PTR_ARRAY_INDEX_ERROR)
+      test_thread->ret_code= 1;
+  }
+  for (j= 0; j < DYN_PTR_TEST_HELD; j++)
+  {
+    if (test_thread->index[j] &&
+        dyn_ptr->dpa_ops.ic_remove_ptr(dyn_ptr,
+                                       test_thread->index[j],
+                                       (void*)&test_thread->objects[j]))
+      test_thread->ret_code= 1;
+  }
+  g_rand_free(random);
+  tp_state->ts_ops.ic_thread_stops(thread_state);
+  DEBUG_THREAD_RETURN;
+}
+
+static int
+test_dynamic_ptr_array_threads()
+{
+  IC_DYNAMIC_PTR_ARRAY *dyn_ptr;
+  IC_THREADPOOL_STATE *tp_state;
+  IC_TEST_DYN_PTR_THREAD *test_threads;
+  guint32 thread_ids[DYN_PTR_TEST_THREADS];
+  guint64 index, max_index;
+  void *ret_object;
+  guint32 i;
+  int ret_code= 1;
+
+  ic_printf("Testing with %u threads inserting and removing concurrently",
+            DYN_PTR_TEST_THREADS);
+  if (!(test_threads= (IC_TEST_DYN_PTR_THREAD*)
+        ic_calloc(DYN_PTR_TEST_THREADS * sizeof(IC_TEST_DYN_PTR_THREAD))))
+    return IC_ERROR_MEM_ALLOC;
+  if (!(dyn_ptr= ic_create_dynamic_ptr_array()))
+  {
+    ic_free(test_threads);
+    return IC_ERROR_MEM_ALLOC;
+  }
+  if (!(tp_state= ic_create_threadpool(DYN_PTR_TEST_THREADS + 1,
+                                       "dyn_ptr_test")))
+    goto error;
+  for (i= 0; i < DYN_PTR_TEST_THREADS; i++)
+  {
+    test_threads[i].dyn_ptr= dyn_ptr;
+    if (tp_state->tp_ops.ic_threadpool_start_thread(tp_state,
+                                                    &thread_ids[i],
+                                                    run_dyn_ptr_thread,
+                                                    &test_threads[i],
+                                                    IC_SMALL_STACK_SIZE,
+                                                    FALSE))
+      abort();
+  }
+  ret_code= 0;
+  for (i= 0; i < DYN_PTR_TEST_THREADS; i++)
+  {
+    tp_state->tp_ops.ic_threadpool_join(tp_state, thread_ids[i]);
+    ret_code|= test_threads[i].ret_code;
+  }
+  tp_state->tp_ops.ic_threadpool_stop(tp_state);
+  if (ret_code)
+    goto error;
+  ret_code= 1;
+  /*
+    Removed entries are reused, so no more entries than the threads held
+    at the same time can have been used. All entries must now be empty.
+  */
+  max_index= dyn_ptr->dpa_ops.ic_get_max_index(dyn_ptr);
+  if (max_index > DYN_PTR_TEST_THREADS * DYN_PTR_TEST_HELD + 1)
+    goto error;
+  for (index= 1; index < max_index; index++)
+  {
+    if (dyn_ptr->dpa_ops.ic_get_ptr(dyn_ptr, index, &ret_object) !=
+          IC_ERROR_PTR_ARRAY_INDEX_ERROR)
+      goto error;
+  }
+  ret_code= 0;
+error:
+  dyn_ptr->dpa_ops.ic_free_dynamic_ptr_array(dyn_ptr);
+  ic_free(test_threads);
+  return ret_code;
+}
+
 static int
 unit_test_dynamic_ptr_array()
 {
@@ -357,25 +516,40 @@ unit_test_dynamic_ptr_array()
     goto error;
   if ((ret_code= test_dynamic_ptr_array(128*128*128+1, 128*128*128+1)))
     goto error;
+  if ((ret_code= test_dynamic_ptr_array_threads()))
+    goto error;
   return 0;
 error:
   return ret_code;
 }
 
+/*
+  A thread owned memory container keeps its base size buffers at reset,
+  so repeating the same allocations after a reset must return the same
+  addresses for all allocations that fit in a base size buffer.
+*/
 static int
-unit_test_mc(gboolean use_mutex, gboolean use_large)
+unit_test_mc(gboolean use_mutex, gboolean use_large, gboolean thread_owned)
 {
   IC_MEMORY_CONTAINER *mc_ptr;
-  guint32 i, j, k, max_alloc_size, no_allocs;
+  gchar *alloc_ptrs[256];
+  gchar *ptr;
+  guint32 i, j, k, max_alloc_size, no_allocs, size, base_size;
   gboolean large;
 
   for (i= 1; i < 1000; i++)
   {
     srandom(i);
-    mc_ptr= ic_create_memory_container(313*i, 0, use_mutex);
+    base_size= 313*i;
+    if (thread_owned)
+      mc_ptr= ic_create_thread_memory_container(base_size, 0);
+    else
+      mc_ptr= ic_create_memory_container(base_size, 0, use_mutex);
     no_allocs= random() & 255;
     for (j= 0; j < 4; j++)
     {
+      if (thread_owned)
+        srandom(1000 + i); /* Same allocations after each reset */
       for (k= 0; k < no_allocs; k++)
       {
         large= ((random() & 3) == 1); /* 25% of allocations are large */
@@ -383,7 +557,17 @@ unit_test_mc(gboolean use_mutex, gboolean use_large)
           max_alloc_size= 32767;
         else
           max_alloc_size= 511;
-        mc_ptr->mc_ops.ic_mc_alloc(mc_ptr, random() & max_alloc_size);
+        size= random() & max_alloc_size;
+        ptr= mc_ptr->mc_ops.ic_mc_alloc(mc_ptr, size);
+        if (!thread_owned || ic_align(size, 8) > ic_align(base_size, 8))
+          continue;
+        if (j == 0)
+          alloc_ptrs[k]= ptr;
+        else if (alloc_ptrs[k] != ptr)
+        {
+          mc_ptr->mc_ops.ic_mc_free(mc_ptr);
+          return 1;
+        }
       }
       mc_ptr->mc_ops.ic_mc_reset(mc_ptr);
     }
@@ -566,6 +750,95 @@ error:
   return ret_code;
 }
 
+/*
+  Test the open addressing hash table, the table starts small such that
+  the inserts and removes are done while entries are moved to a larger
+  table. Every third entry is removed while inserting.
+*/
+static int
+test_oa_hashtable(guint32 num_inserts)
+{
+  int ret_code= 1;
+  guint32 i;
+  void *ret_object;
+  IC_OA_HASHTABLE *hashtable;
+  IC_TEST_HASHTABLE *test_hashtable= (IC_TEST_HASHTABLE*)
+    ic_calloc(sizeof(IC_TEST_HASHTABLE)*num_inserts);
+
+  ic_printf("Testing with %u number of inserts", num_inserts);
+  if (!test_hashtable)
+    abort();
+  if (!(hashtable= ic_create_oa_hashtable(5,
+                                          ic_hash_uint64,
+                                          ic_keys_equal_uint64)))
+  {
+    ic_free(test_hashtable);
+    return IC_ERROR_MEM_ALLOC;
+  }
+  init_test_hashtable(test_hashtable, num_inserts);
+  for (i= 0; i < num_inserts; i++)
+  {
+    if ((ret_code= ic_oa_hashtable_insert(hashtable,
+                                          (void*)&test_hashtable[i].object,
+                                          (void*)&test_hashtable[i].object)))
+      goto error;
+    test_hashtable[i].in_hashtable= TRUE;
+    ret_code= 1;
+    if ((i % 3) == 2)
+    {
+      if (ic_oa_hashtable_remove(hashtable,
+                                 (void*)&test_hashtable[i - 1].object) !=
+          (void*)&test_hashtable[i - 1].object)
+        goto error;
+      test_hashtable[i - 1].in_hashtable= FALSE;
+    }
+  }
+  if (ic_oa_hashtable_count(hashtable) != num_inserts - num_inserts / 3)
+    goto error;
+  for (i= 0; i < num_inserts; i++)
+  {
+    ret_object= ic_oa_hashtable_search(hashtable,
+                                       (void*)&test_hashtable[i].object);
+    if (test_hashtable[i].in_hashtable &&
+        ret_object != (void*)&test_hashtable[i].object)
+      goto error;
+    if (!test_hashtable[i].in_hashtable && ret_object)
+      goto error;
+  }
+  for (i= 0; i < num_inserts; i++)
+  {
+    ret_object= ic_oa_hashtable_remove(hashtable,
+                                       (void*)&test_hashtable[i].object);
+    if (test_hashtable[i].in_hashtable != (ret_object != NULL))
+      goto error;
+  }
+  if (ic_oa_hashtable_count(hashtable) != 0)
+    goto error;
+  ret_code= 0;
+error:
+  ic_oa_hashtable_destroy(hashtable);
+  ic_free(test_hashtable);
+  return ret_code;
+}
+
+static int
+unit_test_oa_hashtable()
+{
+  int ret_code;
+
+  if ((ret_code= test_oa_hashtable(3)))
+    goto error;
+  if ((ret_code= test_oa_hashtable(128)))
+    goto error;
+  if ((ret_code= test_oa_hashtable(128*128+1)))
+    goto error;
+  if ((ret_code= test_oa_hashtable(128*128*128+1)))
+    goto error;
+  return 0;
+error:
+  return ret_code;
+}
+
 /*
   myhost1:1200
   myhost1:1200, Fel
@@ -1142,7 +1415,728 @@ unit_test_sock_buf()
     return 1;
   return 0;
 }
-                         
+
+#define SOCK_BUF_STRESS_THREADS 8
+#define SOCK_BUF_STRESS_PAGES 8192
+#define SOCK_BUF_STRESS_LOOPS 100000
+#define SOCK_BUF_STRESS_HELD 64
+#define SOCK_BUF_STRESS_HANDOFF 256
+#define SOCK_BUF_HANDOFF_MARK 0xFFFFFFFF
+
+/* Pages allocated by one thread and returned by another thread */
+struct ic_test_sock_buf_handoff
+{
+  IC_MUTEX *mutex;
+  IC_SOCK_BUF_PAGE *pages[SOCK_BUF_STRESS_HANDOFF];
+  guint32 num_pages;
+};
+typedef struct ic_test_sock_buf_handoff IC_TEST_SOCK_BUF_HANDOFF;
+
+struct ic_test_sock_buf_thread
+{
+  IC_SOCK_BUF *sock_buf;
+  IC_TEST_SOCK_BUF_HANDOFF *handoff;
+  guint32 thread_id;
+  gboolean release_cache;
+  gboolean release_all_caches;
+  int ret_code;
+};
+typedef struct ic_test_sock_buf_thread IC_TEST_SOCK_BUF_THREAD;
+
+static void
+handoff_sock_buf_page(IC_TEST_SOCK_BUF_THREAD *test_thread,
+                      IC_SOCK_BUF_PAGE **held_pages,
+                      guint32 *num_held)
+{
+  IC_TEST_SOCK_BUF_HANDOFF *handoff= test_thread->handoff;
+  IC_SOCK_BUF_PAGE *page;
+
+  if (*num_held == 0)
+    return;
+  ic_mutex_lock(handoff->mutex);
+  if (handoff->num_pages < SOCK_BUF_STRESS_HANDOFF)
+  {
+    page= held_pages[--(*num_held)];
+    if (page->opaque_area[0] != test_thread->thread_id)
+      test_thread->ret_code= 1;
+    page->opaque_area[0]= SOCK_BUF_HANDOFF_MARK;
+    handoff->pages[handoff->num_pages++]= page;
+  }
+  ic_mutex_unlock(handoff->mutex);
+}
+
+static void
+return_handoff_sock_buf_page(IC_TEST_SOCK_BUF_THREAD *test_thread)
+{
+  IC_TEST_SOCK_BUF_HANDOFF *handoff= test_thread->handoff;
+  IC_SOCK_BUF_PAGE *page= NULL;
+
+  ic_mutex_lock(handoff->mutex);
+  if (handoff->num_pages > 0)
+    page= handoff->pages[--handoff->num_pages];
+  ic_mutex_unlock(handoff->mutex);
+  if (!page)
+    return;
+  if (page->opaque_area[0] != SOCK_BUF_HANDOFF_MARK)
+    test_thread->ret_code= 1;
+  page->opaque_area[0]= test_thread->thread_id;
+  test_thread->sock_buf->sock_buf_ops.ic_return_sock_buf_page(
+    test_thread->sock_buf, page);
+}
+
+/*
+  Each thread allocates and returns pages in random batches and sizes. The
+  thread marks each page it holds and verifies the mark before returning
+  the page, this discovers any page handed out to two threads at the same
+  time. Pages are also handed off to other threads that return them, thus
+  pages move between the caches of the threads. Some threads release
+  their cache of the pool, some release all their caches and the rest
+  rely on the caches being released at thread exit.
+*/
+static gpointer
+run_sock_buf_stress_thread(gpointer data)
+{
+  IC_THREAD_STATE *thread_state= (IC_THREAD_STATE*)data;
+  IC_THREADPOOL_STATE *tp_state= thread_state->ic_get_threadpool(thread_state);
+  IC_TEST_SOCK_BUF_THREAD *test_thread= (IC_TEST_SOCK_BUF_THREAD*)
+    tp_state->ts_ops.ic_thread_get_object(thread_state);
+  IC_SOCK_BUF *sock_buf= test_thread->sock_buf;
+  IC_SOCK_BUF_PAGE *held_pages[SOCK_BUF_STRESS_HELD];
+  IC_SOCK_BUF_PAGE *page;
+  guint32 num_held= 0;
+  guint32 i, j, num_pages, buf_size, action;
+  GRand *random;
+  DEBUG_THREAD_ENTRY("run_sock_buf_stress_thread");
+
+  random= g_rand_new();
+  tp_state->ts_ops.ic_thread_started(thread_state);
+  for (i= 0; i < SOCK_BUF_STRESS_LOOPS; i++)
+  {
+    num_pages= g_rand_int_range(random, 1, 17);
+    action= g_rand_int_range(random, 0, 4);
+    if (action == 2)
+    {
+      for (j= 0; j < num_pages; j++)
+        handoff_sock_buf_page(test_thread, held_pages, &num_held);
+    }
+    else if (action == 3)
+    {
+      for (j= 0; j < num_pages; j++)
+        return_handoff_sock_buf_page(test_thread);
+    }
+    else if (action == 0)
+    {
+      for (j= 0; j < num_pages && num_held < SOCK_BUF_STRESS_HELD; j++)
+      {
+        buf_size= (guint32)g_rand_int_range(random, 0, 3) * 62;
+        if (!(page= sock_buf->sock_buf_ops.ic_get_sock_buf_page(sock_buf,
+                                                                 buf_size,
+                                                                 NULL,
+                                                                 0)))
+          break;
+        page->opaque_area[0]= test_thread->thread_id;
+        held_pages[num_held++]= page;
+      }
+    }
+    else
+    {
+      for (j= 0; j < num_pages && num_held > 0; j++)
+      {
+        page= held_pages[--num_held];
+        if (page->opaque_area[0] != test_thread->thread_id)
+          test_thread->ret_code= 1;
+        sock_buf->sock_buf_ops.ic_return_sock_buf_page(sock_buf, page);
+      }
+    }
+  }
+  while (num_held > 0)
+  {
+    page= held_pages[--num_held];
+    sock_buf->sock_buf_ops.ic_return_sock_buf_page(sock_buf, page);
+  }
+  if (test_thread->release_cache)
+    sock_buf->sock_buf_ops.ic_release_thread_cache(sock_buf);
+  if (test_thread->release_all_caches)
+    ic_release_all_thread_caches();
+  g_rand_free(random);
+  tp_state->ts_ops.ic_thread_stops(thread_state);
+  DEBUG_THREAD_RETURN;
+}
+
+static int
+unit_test_sock_buf_stress()
+{
+  IC_SOCK_BUF *sock_buf;
+  IC_THREADPOOL_STATE *tp_state;
+  IC_TEST_SOCK_BUF_THREAD test_threads[SOCK_BUF_STRESS_THREADS];
+  IC_TEST_SOCK_BUF_HANDOFF handoff;
+  guint32 thread_ids[SOCK_BUF_STRESS_THREADS];
+  guint32 i;
+  int ret_code= 1;
+
+  handoff.num_pages= 0;
+  if (!(handoff.mutex= ic_mutex_create()))
+    return 1;
+  if (!(sock_buf= ic_create_sock_buf(0, SOCK_BUF_STRESS_PAGES)))
+  {
+    ic_mutex_destroy(&handoff.mutex);
+    return 1;
+  }
+  if (!(tp_state= ic_create_threadpool(SOCK_BUF_STRESS_THREADS + 1,
+                                       "sock_buf_stress")))
+    goto error;
+  for (i= 0; i < SOCK_BUF_STRESS_THREADS; i++)
+  {
+    test_threads[i].sock_buf= sock_buf;
+    test_threads[i].handoff= &handoff;
+    test_threads[i].thread_id= i + 1;
+    test_threads[i].release_cache= (i & 1);
+    test_threads[i].release_all_caches= ((i & 3) == 2);
+    test_threads[i].ret_code= 0;
+    if (tp_state->tp_ops.ic_threadpool_start_thread(tp_state,
+                                                    &thread_ids[i],
+                                                    run_sock_buf_stress_thread,
+                                                    &test_threads[i],
+                                                    IC_SMALL_STACK_SIZE,
+                                                    FALSE))
+      abort();
+  }
+  ret_code= 0;
+  for (i= 0; i < SOCK_BUF_STRESS_THREADS; i++)
+  {
+    tp_state->tp_ops.ic_threadpool_join(tp_state, thread_ids[i]);
+    ret_code|= test_threads[i].ret_code;
+  }
+  tp_state->tp_ops.ic_threadpool_stop(tp_state);
+  if (ret_code)
+    goto error;
+  /*
+    Return the pages still handed off, they end up in the cache of this
+    thread which we release before checking the global free list.
+  */
+  while (handoff.num_pages > 0)
+    sock_buf->sock_buf_ops.ic_return_sock_buf_page(sock_buf,
+      handoff.pages[--handoff.num_pages]);
+  ic_release_all_thread_caches();
+  /* All pages must be back in the global free list */
+  ret_code= 1;
+  if (!allocate_all_from_sock_buf(sock_buf,
+                                  SOCK_BUF_STRESS_PAGES,
+                                  (guint32)0,
+                                  (guint32)1,
+                                  NULL))
+    goto error;
+  if (verify_sock_buf_failure(sock_buf, NULL, (guint32)1))
+    goto error;
+  ret_code= 0;
+error:
+  sock_buf->sock_buf_ops.ic_free_sock_buf(sock_buf);
+  ic_mutex_destroy(&handoff.mutex);
+  return ret_code;
+}
+
+#define POLL_SET_TEST_PIPES 4
+static int
+check_poll_set_ready(IC_POLL_SET *poll_set,
+                     int ms_time,
+                     guint32 expected_ready_mask,
+                     guint32 still_ready_mask,
+                     int *pipe_ids)
+{
+  const IC_POLL_CONNECTION *poll_conn;
+  guint32 ready_mask= 0;
+  int *pipe_id;
+
+  if (poll_set->poll_ops.ic_check_poll_set(poll_set, ms_time))
+    return 1;
+  while ((poll_conn= poll_set->poll_ops.ic_get_next_connection(poll_set)))
+  {
+    if (poll_conn->ret_code)
+      return 1;
+    pipe_id= (int*)poll_conn->user_obj;
+    ic_require(pipe_id >= pipe_ids &&
+               pipe_id < pipe_ids + POLL_SET_TEST_PIPES);
+    if (ready_mask & (1 << *pipe_id))
+      return 1;
+    ready_mask|= (1 << *pipe_id);
+    if (still_ready_mask & (1 << *pipe_id))
+      poll_set->poll_ops.ic_poll_set_still_ready(poll_set);
+  }
+  if (ready_mask != expected_ready_mask)
+  {
+    ic_printf("Poll set reported 0x%x, expected 0x%x",
+              ready_mask, expected_ready_mask);
+    return 1;
+  }
+  return 0;
+}
+
+/* Wait for the next write of the poll set to complete */
+static const IC_POLL_WRITE*
+wait_poll_set_write(IC_POLL_SET *poll_set)
+{
+  const IC_POLL_WRITE *poll_write= NULL;
+  guint32 i;
+
+  for (i= 0; i < 100 && !poll_write; i++)
+  {
+    if (poll_set->poll_ops.ic_check_poll_set(poll_set, 10))
+      return NULL;
+    while (poll_set->poll_ops.ic_get_next_connection(poll_set))
+      ;
+    poll_write= poll_set->poll_ops.ic_get_next_write(poll_set);
+  }
+  return poll_write;
+}
+
+static int
+unit_test_poll_set_async_write(IC_POLL_SET *poll_set)
+{
+  const IC_POLL_WRITE *poll_write;
+  IC_IOVEC write_vector[2];
+  int sock_fds[2];
+  gchar buf[16];
+  int ret_code= 1;
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock_fds))
+    return 1;
+  write_vector[0].iov_base= (gchar*)"async";
+  write_vector[0].iov_len= 5;
+  write_vector[1].iov_base= (gchar*)" write";
+  write_vector[1].iov_len= 6;
+  if (poll_set->poll_ops.ic_poll_set_async_writev(poll_set,
+                                                  sock_fds[0],
+                                                  write_vector,
+                                                  2,
+                                                  sock_fds))
+    goto end;
+  poll_write= wait_poll_set_write(poll_set);
+  if (!poll_write ||
+      poll_write->user_obj != (void*)sock_fds ||
+      poll_write->ret_code != 0 ||
+      poll_write->bytes_written != 11)
+    goto end;
+  if (read(sock_fds[1], buf, 11) != 11 ||
+      memcmp(buf, "async write", 11))
+    goto end;
+  ret_code= 0;
+end:
+  close(sock_fds[0]);
+  close(sock_fds[1]);
+  return ret_code;
+}
+
+/*
+  Buffers can only be registered once, so we use a poll set of its own.
+  Registration requires SIGPIPE to be ignored which is done by the
+  application, so we do it here. Registration fails when the limit on
+  locked memory is too low, we have nothing more to test in this case.
+  A single buffer is written from the registered buffer, a
+  write of several buffers is still one sendmsg. The write to cancel is
+  made when the socket buffer is full such that it waits for the reader.
+*/
+#define POLL_SET_TEST_FILL_SIZE 4096
+static int
+unit_test_poll_set_fixed_write()
+{
+  IC_POLL_SET *poll_set;
+  const IC_POLL_WRITE *poll_write;
+  IC_IOVEC areas[2];
+  IC_IOVEC write_vector[2];
+  gchar data[32];
+  gchar fill_buf[POLL_SET_TEST_FILL_SIZE];
+  gchar buf[16];
+  int sock_fds[2]= { -1, -1 };
+  int ret_code= 1;
+
+  if (!(poll_set= ic_create_poll_set()))
+    return 1;
+  if (!poll_set->poll_ops.ic_poll_set_has_async_write(poll_set))
+  {
+    poll_set->poll_ops.ic_free_poll_set(poll_set);
+    return 0;
+  }
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock_fds))
+    goto end;
+  signal(SIGPIPE, SIG_IGN);
+  memcpy(data, "fixed buffers", 13);
+  ic_zero(fill_buf, sizeof(fill_buf));
+  areas[0].iov_base= data;
+  areas[0].iov_len= sizeof(data);
+  areas[1].iov_base= fill_buf;
+  areas[1].iov_len= sizeof(fill_buf);
+  if (poll_set->poll_ops.ic_poll_set_register_write_buffers(poll_set,
+                                                            areas,
+                                                            2))
+  {
+    ret_code= 0;
+    goto end;
+  }
+  write_vector[0].iov_base= data;
+  write_vector[0].iov_len= 13;
+  if (poll_set->poll_ops.ic_poll_set_async_writev(poll_set,
+                                                  sock_fds[0],
+                                                  write_vector,
+                                                  1,
+                                                  sock_fds))
+    goto end;
+  poll_write= wait_poll_set_write(poll_set);
+  if (!poll_write ||
+      poll_write->user_obj != (void*)sock_fds ||
+      poll_write->ret_code != 0 ||
+      poll_write->bytes_written != 13)
+    goto end;
+  if (read(sock_fds[1], buf, 13) != 13 ||
+      memcmp(buf, "fixed buffers", 13))
+    goto end;
+
+  write_vector[0].iov_len= 5;
+  write_vector[1].iov_base= data + 5;
+  write_vector[1].iov_len= 8;
+  if (poll_set->poll_ops.ic_poll_set_async_writev(poll_set,
+                                                  sock_fds[0],
+                                                  write_vector,
+                                                  2,
+                                                  sock_fds))
+    goto end;
+  poll_write= wait_poll_set_write(poll_set);
+  if (!poll_write ||
+      poll_write->ret_code != 0 ||
+      poll_write->bytes_written != 13)
+    goto end;
+  if (read(sock_fds[1], buf, 13) != 13 ||
+      memcmp(buf, "fixed buffers", 13))
+    goto end;
+
+  while (send(sock_fds[0], fill_buf, sizeof(fill_buf), MSG_DONTWAIT) > 0)
+    ;
+  write_vector[0].iov_base= fill_buf;
+  write_vector[0].iov_len= 200;
+  if (poll_set->poll_ops.ic_poll_set_async_writev(poll_set,
+                                                  sock_fds[0],
+                                                  write_vector,
+                                                  1,
+                                                  sock_fds) ||
+      poll_set->poll_ops.ic_check_poll_set(poll_set, 10) ||
+      poll_set->poll_ops.ic_get_next_write(poll_set) ||
+      poll_set->poll_ops.ic_poll_set_cancel_write(poll_set, sock_fds))
+    goto end;
+  poll_write= wait_poll_set_write(poll_set);
+  if (!poll_write ||
+      poll_write->ret_code != ECANCELED ||
+      poll_write->bytes_written != 0)
+    goto end;
+  ret_code= 0;
+end:
+  poll_set->poll_ops.ic_free_poll_set(poll_set);
+  if (sock_fds[0] != -1)
+  {
+    close(sock_fds[0]);
+    close(sock_fds[1]);
+  }
+  return ret_code;
+}
+
+/*
+  Wait for the next read of the poll set, the data is appended to buf and
+  the buffer read into is provided again.
+*/
+#define POLL_SET_TEST_READ_BUF_SIZE 16
+static const IC_POLL_READ*
+wait_poll_set_read(IC_POLL_SET *poll_set,
+                   gchar bufs[][POLL_SET_TEST_READ_BUF_SIZE],
+                   gchar *buf,
+                   guint32 *buf_size)
+{
+  const IC_POLL_READ *poll_read= NULL;
+  guint32 i;
+
+  for (i= 0; i < 100 && !poll_read; i++)
+  {
+    if (poll_set->poll_ops.ic_check_poll_set(poll_set, 10))
+      return NULL;
+    poll_read= poll_set->poll_ops.ic_get_next_read(poll_set);
+  }
+  if (!poll_read || poll_read->ret_code)
+    return poll_read;
+  memcpy(buf + *buf_size, bufs[poll_read->buf_id], poll_read->bytes_read);
+  *buf_size+= poll_read->bytes_read;
+  if (poll_set->poll_ops.ic_poll_set_provide_read_buffer(poll_set,
+                                  bufs[poll_read->buf_id],
+                                  POLL_SET_TEST_READ_BUF_SIZE,
+                                  poll_read->buf_id))
+    return NULL;
+  return poll_read;
+}
+
+/*
+  Reads by the poll set are only supported by some implementations, a
+  poll set reading by itself reports no ready connections so we use a
+  poll set of its own.
+*/
+static int
+unit_test_poll_set_async_read()
+{
+  IC_POLL_SET *poll_set;
+  const IC_POLL_READ *poll_read;
+  gchar bufs[2][POLL_SET_TEST_READ_BUF_SIZE];
+  gchar buf[32];
+  guint32 i, buf_size= 0;
+  int sock_fds[2]= { -1, -1 };
+  int ret_code= 1;
+
+  if (!(poll_set= ic_create_poll_set()))
+    return 1;
+  if (!poll_set->poll_ops.ic_poll_set_has_async_read(poll_set))
+  {
+    poll_set->poll_ops.ic_free_poll_set(poll_set);
+    return 0;
+  }
+  for (i= 0; i < 2; i++)
+  {
+    if (poll_set->poll_ops.ic_poll_set_provide_read_buffer(poll_set,
+                                    bufs[i],
+                                    POLL_SET_TEST_READ_BUF_SIZE,
+                                    i))
+      goto end;
+  }
+  /* All buffers must have the same size */
+  if (!poll_set->poll_ops.ic_poll_set_provide_read_buffer(poll_set,
+                                   buf,
+                                   sizeof(buf),
+                                   1))
+    goto end;
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock_fds) ||
+      poll_set->poll_ops.ic_poll_set_add_connection(poll_set,
+                                                    sock_fds[1],
+                                                    sock_fds))
+    goto end;
+  if (write(sock_fds[0], "async read", 10) != 10 ||
+      !(poll_read= wait_poll_set_read(poll_set, bufs, buf, &buf_size)) ||
+      poll_read->user_obj != (void*)sock_fds ||
+      poll_read->ret_code != 0 ||
+      buf_size != 10 ||
+      memcmp(buf, "async read", 10))
+    goto end;
+  /* More data than fits in one buffer is read in several reads */
+  buf_size= 0;
+  if (write(sock_fds[0], "0123456789abcdefghij", 20) != 20)
+    goto end;
+  while (buf_size < 20)
+  {
+    if (!(poll_read= wait_poll_set_read(poll_set, bufs, buf, &buf_size)) ||
+        poll_read->ret_code)
+      goto end;
+  }
+  if (buf_size != 20 || memcmp(buf, "0123456789abcdefghij", 20))
+    goto end;
+  /*
+    Data is either read before the removal or left in the socket, we arm
+    the socket and give the kernel time to read before removing it.
+  */
+  if (poll_set->poll_ops.ic_check_poll_set(poll_set, 0) ||
+      poll_set->poll_ops.ic_get_next_read(poll_set) ||
+      write(sock_fds[0], "x", 1) != 1)
+    goto end;
+  ic_microsleep(10000);
+  if (poll_set->poll_ops.ic_poll_set_remove_connection(poll_set,
+                                                       sock_fds[1]))
+    goto end;
+  if ((poll_read= poll_set->poll_ops.ic_get_next_read(poll_set)))
+  {
+    if (poll_read->user_obj != (void*)sock_fds ||
+        poll_read->bytes_read != 1 ||
+        bufs[poll_read->buf_id][0] != 'x' ||
+        poll_set->poll_ops.ic_get_next_read(poll_set))
+      goto end;
+  }
+  else if (read(sock_fds[1], buf, 1) != 1 || buf[0] != 'x')
+    goto end;
+  /* Closing the other end is reported as end of file */
+  if (poll_set->poll_ops.ic_poll_set_add_connection(poll_set,
+                                                    sock_fds[1],
+                                                    sock_fds))
+    goto end;
+  close(sock_fds[0]);
+  sock_fds[0]= -1;
+  if (!(poll_read= wait_poll_set_read(poll_set, bufs, buf, &buf_size)) ||
+      poll_read->ret_code != IC_END_OF_FILE)
+    goto end;
+  ret_code= 0;
+end:
+  poll_set->poll_ops.ic_free_poll_set(poll_set);
+  if (sock_fds[0] >= 0)
+    close(sock_fds[0]);
+  if (sock_fds[1] >= 0)
+    close(sock_fds[1]);
+  return ret_code;
+}
+
+/*
+  Add more connections than the initial size of the poll set, all are
+  duplicates of the same pipe, so all are reported on one write.
+*/
+#define POLL_SET_TEST_GROW 200
+static int
+unit_test_poll_set_grow(IC_POLL_SET *poll_set)
+{
+  int pipe_fds[2];
+  int dup_fds[POLL_SET_TEST_GROW];
+  guint32 i, num_dups= 0, num_ready= 0;
+  int ret_code= 1;
+
+  if (pipe(pipe_fds))
+    return 1;
+  for (i= 0; i < POLL_SET_TEST_GROW; i++)
+  {
+    if ((dup_fds[i]= dup(pipe_fds[0])) < 0)
+      goto end;
+    num_dups++;
+    if (poll_set->poll_ops.ic_poll_set_add_connection(poll_set,
+                                                      dup_fds[i],
+                                                      &dup_fds[i]))
+      goto end;
+  }
+  if (write(pipe_fds[1], "g", 1) != 1)
+    goto end;
+  if (poll_set->poll_ops.ic_check_poll_set(poll_set, 1000))
+    goto end;
+  while (poll_set->poll_ops.ic_get_next_connection(poll_set))
+    num_ready++;
+  if (num_ready != POLL_SET_TEST_GROW)
+  {
+    ic_printf("Poll set reported %u connections, expected %u",
+              num_ready, POLL_SET_TEST_GROW);
+    goto end;
+  }
+  for (i= 0; i < num_dups; i++)
+  {
+    if (poll_set->poll_ops.ic_poll_set_remove_connection(poll_set,
+                                                         dup_fds[i]))
+      goto end;
+  }
+  ret_code= 0;
+end:
+  for (i= 0; i < num_dups; i++)
+    close(dup_fds[i]);
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+  return ret_code;
+}
+
+static int
+unit_test_poll_set()
+{
+  IC_POLL_SET *poll_set;
+  int pipe_fds[POLL_SET_TEST_PIPES][2];
+  int pipe_ids[POLL_SET_TEST_PIPES];
+  gchar buf[8];
+  guint32 i, num_pipes= 0;
+  int ret_code= 1;
+
+  if (!(poll_set= ic_create_poll_set()))
+    return 1;
+  for (i= 0; i < POLL_SET_TEST_PIPES; i++)
+  {
+    if (pipe(pipe_fds[i]))
+      goto error;
+    num_pipes++;
+    pipe_ids[i]= (int)i;
+    if (poll_set->poll_ops.ic_poll_set_add_connection(poll_set,
+                                                      pipe_fds[i][0],
+                                                      &pipe_ids[i]))
+      goto error;
+  }
+  /* Nothing written yet */
+  if (check_poll_set_ready(poll_set, 0, 0, 0, pipe_ids))
+    goto error;
+  if (write(pipe_fds[1][1], "a", 1) != 1 ||
+      write(pipe_fds[3][1], "b", 1) != 1)
+    goto error;
+  if (check_poll_set_ready(poll_set, 1000, 0xA, 0x2, pipe_ids))
+    goto error;
+  /* Data not read from pipe 1, must be reported again without waiting */
+  if (read(pipe_fds[3][0], buf, 1) != 1)
+    goto error;
+  if (check_poll_set_ready(poll_set, 1000, 0x2, 0, pipe_ids))
+    goto error;
+  if (read(pipe_fds[1][0], buf, 1) != 1)
+    goto error;
+  if (check_poll_set_ready(poll_set, 10, 0, 0, pipe_ids))
+    goto error;
+  /* A removed connection is no longer reported */
+  if (poll_set->poll_ops.ic_poll_set_remove_connection(poll_set,
+                                                       pipe_fds[1][0]))
+    goto error;
+  if (write(pipe_fds[1][1], "c", 1) != 1 ||
+      write(pipe_fds[2][1], "d", 1) != 1)
+    goto error;
+  if (check_poll_set_ready(poll_set, 1000, 0x4, 0x4, pipe_ids))
+    goto error;
+  /* Reuse the slot of the removed connection */
+  if (poll_set->poll_ops.ic_poll_set_add_connection(poll_set,
+                                                    pipe_fds[1][0],
+                                                    &pipe_ids[1]))
+    goto error;
+  if (check_poll_set_ready(poll_set, 1000, 0x6, 0, pipe_ids))
+    goto error;
+  if (read(pipe_fds[1][0], buf, 1) != 1 ||
+      read(pipe_fds[2][0], buf, 1) != 1)
+    goto error;
+  /* Asynchronous writes are only supported by some implementations */
+  if (poll_set->poll_ops.ic_poll_set_has_async_write(poll_set) &&
+      unit_test_poll_set_async_write(poll_set))
+    goto error;
+  if (unit_test_poll_set_fixed_write())
+    goto error;
+  if (unit_test_poll_set_grow(poll_set))
+    goto error;
+  if (unit_test_poll_set_async_read())
+    goto error;
+  ret_code= 0;
+error:
+  poll_set->poll_ops.ic_free_poll_set(poll_set);
+  for (i= 0; i < num_pipes; i++)
+  {
+    close(pipe_fds[i][0]);
+    close(pipe_fds[i][1]);
+  }
+  return ret_code;
+}
+
+#define WORD_OPS_TEST_WORDS 67
+static int
+unit_test_word_ops()
+{
+  guint32 words[WORD_OPS_TEST_WORDS + 1];
+  guint32 start, num_words, i, xor_result, swapped;
+
+  /* Cover all tail lengths and unaligned starts of the SIMD variants */
+  for (start= 0; start < 2; start++)
+  {
+    for (num_words= 0; num_words <= WORD_OPS_TEST_WORDS - start; num_words++)
+    {
+      xor_result= 0;
+      for (i= 0; i <= WORD_OPS_TEST_WORDS; i++)
+        words[i]= (i * 0x9E3779B9) ^ (num_words << 8);
+      for (i= start; i < start + num_words; i++)
+        xor_result^= words[i];
+      if (ic_xor_words(&words[start], num_words) != xor_result)
+        return 1;
+      ic_swap_endian_words(&words[start], num_words);
+      for (i= 0; i <= WORD_OPS_TEST_WORDS; i++)
+      {
+        swapped= (i * 0x9E3779B9) ^ (num_words << 8);
+        if (i >= start && i < start + num_words)
+          ic_swap_endian_word(swapped);
+        if (words[i] != swapped)
+          return 1;
+      }
+    }
+  }
+  return 0;
+}
+
 static int
 run_test(guint32 test_type)
 {
@@ -1152,10 +2146,13 @@ run_test(guint32 test_type)
   {
     case 1:
       ic_printf("Test 1: Executing Unit test of Memory Container");
-      ret_code= unit_test_mc(FALSE, FALSE);
-      ret_code= unit_test_mc(FALSE, TRUE);
-      ret_code= unit_test_mc(TRUE, FALSE);
-      ret_code= unit_test_mc(TRUE, TRUE);
+      ret_code= unit_test_mc(FALSE, FALSE, FALSE);
+      ret_code|= unit_test_mc(FALSE, TRUE, FALSE);
+      ret_code|= unit_test_mc(TRUE, FALSE, FALSE);
+      ret_code|= unit_test_mc(TRUE, TRUE, FALSE);
+      ret_code|= unit_test_mc(FALSE, FALSE, TRUE);
+      ret_code|= unit_test_mc(FALSE, TRUE, TRUE);
+      ret_code|= ic_unit_test_thread_mc();
       break;
 
     case 2:
@@ -1186,6 +2183,54 @@ run_test(guint32 test_type)
       ic_printf("Test 8: Executing unit test of Socket Buffer");
       ret_code= unit_test_sock_buf();
       break;
+    case 9:
+      ic_printf("Test 9: Executing stress test of Socket Buffer thread caches");
+      ret_code= unit_test_sock_buf_stress();
+      break;
+    case 10:
+      ic_printf("Test 10: Executing unit test of Poll Set");
+      ret_code= unit_test_poll_set();
+      break;
+    case 11:
+      ic_printf("Test 11: Executing unit test of NDB message word operations");
+      ret_code= unit_test_word_ops();
+      break;
+    case 12:
+      ic_printf("Test 12: Executing unit test of Open Addressing Hashtable");
+      ret_code= unit_test_oa_hashtable();
+      break;
+    case 13:
+      ic_printf("Test 13: Executing unit test of Data API transactions");
+      ret_code= ic_unit_test_apid_trans();
+      break;
+    case 14:
+      ic_printf("Test 14: Executing unit test of NDB key hash");
+      ret_code= ic_unit_test_apid_key_hash();
+      break;
+    case 15:
+      ic_printf("Test 15: Executing unit test of WHERE condition compiling");
+      ret_code= ic_unit_test_apid_where();
+      break;
+    case 16:
+      ic_printf("Test 16: Executing unit test of WHERE condition evaluation");
+      ret_code= ic_unit_test_apid_where_eval();
+      break;
+    case 17:
+      ic_printf("Test 17: Executing unit test of concurrent table cache use");
+      ret_code= ic_unit_test_apid_table_cache();
+      break;
+    case 18:
+      ic_printf("Test 18: Executing unit test of RECORD_INFO decoding");
+      ret_code= ic_unit_test_apid_record_info();
+      break;
+    case 19:
+      ic_printf("Test 19: Executing unit test of packed message splitting");
+      ret_code= ic_unit_test_apid_packed_message();
+      break;
+    case 20:
+      ic_printf("Test 20: Executing unit test of scans");
+      ret_code= ic_unit_test_apid_scan();
+      break;
     default:
       ret_code= 0;
       ic_require(FALSE);
@@ -1209,7 +2254,7 @@ int main(int argc, char *argv[])
     return ret_code;
   if (glob_test_type == 0)
   {
-    for (i= 1; i < 9; i++)
+    for (i= 1; i < 21; i++)
     {
       if ((ret_code= run_test(i)))
         break;
@@ -221,6 +221,57 @@ void ic_debug_indent_level_check(int level)
   ic_require((int)thread_debug->indent_level == level);
 }
 
+void
+ic_debug_trace(guint32 event, guint32 data1, guint32 data2)
+{
+  IC_THREAD_DEBUG *thread_debug;
+  IC_DEBUG_TRACE_ENTRY *trace_entry;
+
+  /* No formatting and no locks here, this is called in the hot path */
+  thread_debug= (IC_THREAD_DEBUG*)g_private_get(&debug_priv);
+  if (!thread_debug)
+    return;
+  trace_entry= &thread_debug->trace[thread_debug->trace_index &
+                                    (IC_DEBUG_TRACE_SIZE - 1)];
+  thread_debug->trace_index++;
+  trace_entry->timestamp= ic_gethrtime();
+  trace_entry->event= event;
+  trace_entry->data1= data1;
+  trace_entry->data2= data2;
+}
+
+void
+ic_debug_trace_dump()
+{
+  IC_THREAD_DEBUG *thread_debug;
+  IC_DEBUG_TRACE_ENTRY *trace_entry;
+  IC_TIMER micros_time;
+  guint32 i, start_index, len;
+  gchar buf[128];
+
+  thread_debug= (IC_THREAD_DEBUG*)g_private_get(&debug_priv);
+  if (!thread_debug)
+    return;
+  start_index= 0;
+  if (thread_debug->trace_index > IC_DEBUG_TRACE_SIZE)
+    start_index= thread_debug->trace_index - IC_DEBUG_TRACE_SIZE;
+  for (i= start_index; i < thread_debug->trace_index; i++)
+  {
+    trace_entry= &thread_debug->trace[i & (IC_DEBUG_TRACE_SIZE - 1)];
+    micros_time= ic_micros_elapsed(debug_start_time, trace_entry->timestamp);
+    len= g_snprintf(buf,
+                    128,
+                    "Trace %u: time= %llu, event= %u, data= %u, %u",
+                    i,
+                    (unsigned long long)micros_time,
+                    trace_entry->event,
+                    trace_entry->data1,
+                    trace_entry->data2);
+    ic_require(len < 128);
+    ic_debug_print_char_buf(buf, thread_debug);
+  }
+}
+
 void ic_debug_thread_return()
 {
   guint32 len;
@@ -241,6 +292,8 @@ void ic_debug_thread_return()
     ic_require(len < 64);
     ic_debug_print_char_buf(buf, thread_debug);
   }
+  if (ic_get_debug() & TRACE_LEVEL)
+    ic_debug_trace_dump();
   ic_require(thread_debug->indent_level == 0);
   ic_mutex_lock_low(debug_mutex);
   ic_num_threads_debugged--;
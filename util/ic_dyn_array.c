@@ -610,113 +610,118 @@ ic_create_ordered_dynamic_array()
   return (IC_DYNAMIC_ARRAY*)dyn_array;
 }
 
-static int
-read_dynamic_ptr_array(IC_DYNAMIC_ARRAY *ext_dyn_array,
-                       guint64 position,
-                       guint64 size,
-                       gchar *buf)
+/* Bit number of the highest bit set, value must not be 0 */
+static inline guint32
+get_highest_bit_no(guint32 value)
 {
-  IC_DYNAMIC_ARRAY_INT *dyn_array= (IC_DYNAMIC_ARRAY_INT*)ext_dyn_array;
-  IC_SIMPLE_DYNAMIC_BUF *dyn_buf= NULL;
-  guint64 buf_pos;
-  gchar *read_buf;
-  int ret_code;
-
-  if ((ret_code= find_pos_ordered_dyn_array(dyn_array, position,
-                                            &dyn_buf, &buf_pos)))
-    return ret_code;
-  read_buf= (gchar*)&dyn_buf->buf[0];
-  read_buf+= buf_pos;
-  memcpy(buf, read_buf, (size_t)size);
-  return 0;
+#ifdef __GNUC__
+  return 31 - (guint32)__builtin_clz(value);
+#else
+  guint32 bit_no= 0;
+  guint32 shift;
+
+  /* Binary search in five fixed steps */
+  for (shift= 16; shift > 0; shift>>= 1)
+  {
+    if (value >= ((guint32)1 << shift))
+    {
+      value>>= shift;
+      bit_no+= shift;
+    }
+  }
+  return bit_no;
+#endif
 }
 
-static int
-write_dynamic_ptr_array(IC_DYNAMIC_ARRAY *ext_dyn_array,
-                        guint64 position,
-                        guint64 size,
-                        const gchar *buf)
+static IC_PTR_ARRAY_SLOT*
+get_ptr_array_slot(IC_DYNAMIC_PTR_ARRAY_INT *dyn_ptr,
+                   guint32 index,
+                   gboolean create)
 {
-  IC_DYNAMIC_ARRAY_INT *dyn_array= (IC_DYNAMIC_ARRAY_INT*)ext_dyn_array;
-  IC_SIMPLE_DYNAMIC_BUF *dyn_buf= NULL;
-  guint64 buf_pos= 0;
-  gchar *write_buf;
-  int ret_code;
+  IC_PTR_ARRAY_SLOT *segment, *new_segment;
+  guint32 segment_no, first_index, segment_size;
 
-  (void)size;
-  if ((ret_code= find_pos_ordered_dyn_array(dyn_array, position,
-                                            &dyn_buf, &buf_pos)))
-    return ret_code;
-  write_buf= (gchar*)&dyn_buf->buf[0];
-  write_buf+= buf_pos;
-  memcpy(write_buf, buf, sizeof(IC_PTR_ARRAY_ENTRY));
-  return 0;
+  /*
+    Segment k starts at index FIRST_SEGMENT_SIZE * (2^k - 1), so the
+    segment is the highest bit set in index / FIRST_SEGMENT_SIZE + 1.
+  */
+  segment_no= get_highest_bit_no(index / IC_PTR_ARRAY_FIRST_SEGMENT_SIZE + 1);
+  ic_assert(segment_no < IC_PTR_ARRAY_MAX_SEGMENTS);
+  segment_size= IC_PTR_ARRAY_FIRST_SEGMENT_SIZE << segment_no;
+  first_index= segment_size - IC_PTR_ARRAY_FIRST_SEGMENT_SIZE;
+  segment= (IC_PTR_ARRAY_SLOT*)
+    g_atomic_pointer_get(&dyn_ptr->segments[segment_no]);
+  if (!segment && create)
+  {
+    /*
+      Several threads can get the first index in a segment at the same
+      time, only one of them gets its segment published.
+    */
+    if (!(new_segment= (IC_PTR_ARRAY_SLOT*)
+          ic_calloc(segment_size * sizeof(IC_PTR_ARRAY_SLOT))))
+      return NULL;
+    if (g_atomic_pointer_compare_and_exchange(&dyn_ptr->segments[segment_no],
+                                              NULL,
+                                              new_segment))
+      segment= new_segment;
+    else
+    {
+      ic_free((void*)new_segment);
+      segment= (IC_PTR_ARRAY_SLOT*)
+        g_atomic_pointer_get(&dyn_ptr->segments[segment_no]);
+    }
+  }
+  if (!segment)
+    return NULL;
+  return &segment[index - first_index];
 }
 
-#define HIGHEST_BIT_SET (guint64)((guint64)1 << 63)
 static int
 insert_ptr(IC_DYNAMIC_PTR_ARRAY *ext_dyn_ptr,
            guint64 *position,
            void *object)
 {
-  IC_PTR_ARRAY_ENTRY ptr_entry, first_entry;
-  guint64 pos_first= (guint64)0;
-  guint64 pos_first_free;
-  guint64 entry_size= sizeof(IC_PTR_ARRAY_ENTRY);
   IC_DYNAMIC_PTR_ARRAY_INT *dyn_ptr=
     (IC_DYNAMIC_PTR_ARRAY_INT*)ext_dyn_ptr;
-  IC_DYNAMIC_ARRAY_INT *dyn_array= dyn_ptr->dyn_array;
+  IC_PTR_ARRAY_SLOT *slot;
+  guint32 free_head, new_free_head, index;
 
-  if (read_dynamic_ptr_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                             pos_first,
-                             entry_size,
-                             (gchar*)&ptr_entry))
-    abort();
-  pos_first_free= ptr_entry.position;
-  if (pos_first_free == (guint64)0)
+  do
+  {
+    free_head= (guint32)g_atomic_int_get(&dyn_ptr->free_head);
+    index= free_head & IC_PTR_ARRAY_INDEX_MASK;
+    if (index == 0)
+      break;
+    slot= get_ptr_array_slot(dyn_ptr, index, FALSE);
+    new_free_head= (guint32)g_atomic_int_get(&slot->next_free) |
+      ((free_head + (1 << IC_PTR_ARRAY_INDEX_BITS)) &
+       ~IC_PTR_ARRAY_INDEX_MASK);
+  } while (!g_atomic_int_compare_and_exchange(&dyn_ptr->free_head,
+                                              (gint)free_head,
+                                              (gint)new_free_head));
+  if (index == 0)
   {
     /*
       All entries were already used, we need to extend the
       array
     */
-    pos_first_free= dyn_array->da_ops.ic_get_current_size(
-      (IC_DYNAMIC_ARRAY*)dyn_array);
-    ptr_entry.object= object;
-    if (insert_ordered_dynamic_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                                     (const gchar*)&ptr_entry,
-                                     entry_size))
+    do
     {
-      /* Memory allocation error */
+      index= (guint32)g_atomic_int_get(&dyn_ptr->next_index);
+      if (index > IC_PTR_ARRAY_MAX_INDEX)
+        return IC_ERROR_MEM_ALLOC;
+    } while (!g_atomic_int_compare_and_exchange(&dyn_ptr->next_index,
+                                                (gint)index,
+                                                (gint)(index + 1)));
+    if (!(slot= get_ptr_array_slot(dyn_ptr, index, TRUE)))
+    {
+      /* Memory allocation error, the index is never used */
       return IC_ERROR_MEM_ALLOC;
     }
   }
-  else
-  {
-    /*
-      Use the free entry but also keep the free list up to date
-      by reading the next free from the first free.
-    */
-    if (read_dynamic_ptr_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                               pos_first_free,
-                               entry_size,
-                               (gchar*)&ptr_entry))
-      abort();
-    if (ptr_entry.position < HIGHEST_BIT_SET)
-      abort();
-    first_entry.position= ptr_entry.position - HIGHEST_BIT_SET;
-    if (write_dynamic_ptr_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                                pos_first,
-                                entry_size,
-                                (const gchar*)&first_entry))
-      abort();
-    ptr_entry.object= object;
-    if (write_dynamic_ptr_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                                pos_first_free,
-                                entry_size,
-                                (gchar*)&ptr_entry))
-      abort();
-  }
-  *position= pos_first_free/sizeof(IC_PTR_ARRAY_ENTRY);
+  /* Publish the object, it can be found by other threads from here */
+  g_atomic_pointer_set(&slot->object, object);
+  *position= (guint64)index;
   return 0;
 }
 
@@ -727,20 +732,21 @@ get_ptr(IC_DYNAMIC_PTR_ARRAY *ext_dyn_ptr,
 {
   IC_DYNAMIC_PTR_ARRAY_INT *dyn_ptr=
     (IC_DYNAMIC_PTR_ARRAY_INT*)ext_dyn_ptr;
-  IC_DYNAMIC_ARRAY_INT *dyn_array= dyn_ptr->dyn_array;
-  IC_PTR_ARRAY_ENTRY ptr_entry;
-  guint64 position= index * sizeof(IC_PTR_ARRAY_ENTRY);
-
-  if (read_dynamic_ptr_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                             position,
-                             sizeof(IC_PTR_ARRAY_ENTRY),
-                             (gchar*)&ptr_entry))
+  IC_PTR_ARRAY_SLOT *slot;
+  void *loc_object;
+
+  if (index == (guint64)0)
   {
-    return IC_ERROR_PTR_ARRAY_INDEX_OUT_OF_BOUND;
+    /* Index 0 is never used, it's reported as an empty entry */
+    *object= NULL;
+    return 0;
   }
-  if (ptr_entry.position >= HIGHEST_BIT_SET)
+  if (index >= (guint64)g_atomic_int_get(&dyn_ptr->next_index) ||
+      !(slot= get_ptr_array_slot(dyn_ptr, (guint32)index, FALSE)))
+    return IC_ERROR_PTR_ARRAY_INDEX_OUT_OF_BOUND;
+  if (!(loc_object= g_atomic_pointer_get(&slot->object)))
     return IC_ERROR_PTR_ARRAY_INDEX_ERROR;
-  *object= ptr_entry.object;
+  *object= loc_object;
   return 0;
 }
 
@@ -749,50 +755,36 @@ remove_ptr(IC_DYNAMIC_PTR_ARRAY *ext_dyn_ptr,
            guint64 index,
            void *object)
 {
-  IC_PTR_ARRAY_ENTRY ptr_entry, first_pos_ptr_entry;
-  guint64 pos_first= (guint64)0;
-  guint64 position= index * sizeof(IC_PTR_ARRAY_ENTRY);
-  guint64 entry_size= sizeof(IC_PTR_ARRAY_ENTRY);
   IC_DYNAMIC_PTR_ARRAY_INT *dyn_ptr=
     (IC_DYNAMIC_PTR_ARRAY_INT*)ext_dyn_ptr;
-  IC_DYNAMIC_ARRAY_INT *dyn_array= dyn_ptr->dyn_array;
+  IC_PTR_ARRAY_SLOT *slot;
+  guint32 free_head, new_free_head;
 
   if (index == (guint64)0)
     return IC_ERROR_INDEX_ZERO_NOT_ALLOWED;
-  if (read_dynamic_ptr_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                             position,
-                             entry_size,
-                             (gchar*)&ptr_entry))
+  if (index >= (guint64)g_atomic_int_get(&dyn_ptr->next_index) ||
+      !(slot= get_ptr_array_slot(dyn_ptr, (guint32)index, FALSE)))
   {
     /* Serious error cannot find entry to remove */
     abort();
   }
-  if (ptr_entry.object != object)
+  if (g_atomic_pointer_get(&slot->object) != object)
   {
     /* Serious error, wrong object where positioned */
     abort();
   }
-  if (read_dynamic_ptr_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                             pos_first,
-                             entry_size,
-                             (gchar*)&ptr_entry))
+  g_atomic_pointer_set(&slot->object, NULL);
+  do
   {
-    /* Serious error cannot find entry to remove */
-    abort();
-  }
-  first_pos_ptr_entry= ptr_entry;
-  ptr_entry.position+= HIGHEST_BIT_SET;
-  if (write_dynamic_ptr_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                              position,
-                              entry_size,
-                              (gchar*)&ptr_entry))
-    abort();
-  ptr_entry.position= position;
-  if (write_dynamic_ptr_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                              pos_first,
-                              entry_size,
-                              (gchar*)&first_pos_ptr_entry))
-    abort();
+    free_head= (guint32)g_atomic_int_get(&dyn_ptr->free_head);
+    g_atomic_int_set(&slot->next_free,
+                     (gint)(free_head & IC_PTR_ARRAY_INDEX_MASK));
+    new_free_head= (guint32)index |
+      ((free_head + (1 << IC_PTR_ARRAY_INDEX_BITS)) &
+       ~IC_PTR_ARRAY_INDEX_MASK);
+  } while (!g_atomic_int_compare_and_exchange(&dyn_ptr->free_head,
+                                              (gint)free_head,
+                                              (gint)new_free_head));
   return 0;
 }
 
@@ -802,9 +794,13 @@ free_dynamic_ptr_array(IC_DYNAMIC_PTR_ARRAY *ext_dyn_ptr)
   DEBUG_ENTRY("free_dynamic_ptr_array");
   IC_DYNAMIC_PTR_ARRAY_INT *dyn_ptr=
     (IC_DYNAMIC_PTR_ARRAY_INT*)ext_dyn_ptr;
-  IC_DYNAMIC_ARRAY_INT *dyn_array= dyn_ptr->dyn_array;
+  guint32 i;
 
-  free_ordered_dynamic_array((IC_DYNAMIC_ARRAY*)dyn_array);
+  for (i= 0; i < IC_PTR_ARRAY_MAX_SEGMENTS; i++)
+  {
+    if (dyn_ptr->segments[i])
+      ic_free((void*)dyn_ptr->segments[i]);
+  }
   ic_free((void*)dyn_ptr);
   DEBUG_RETURN_EMPTY;
 }
@@ -812,20 +808,15 @@ free_dynamic_ptr_array(IC_DYNAMIC_PTR_ARRAY *ext_dyn_ptr)
 guint64
 get_max_index(IC_DYNAMIC_PTR_ARRAY *ext_dyn_ptr)
 {
-  guint64 size;
   IC_DYNAMIC_PTR_ARRAY_INT *dyn_ptr=
     (IC_DYNAMIC_PTR_ARRAY_INT*)ext_dyn_ptr;
-  IC_DYNAMIC_ARRAY_INT *dyn_array= dyn_ptr->dyn_array;
 
-  size= dyn_array->total_size_in_bytes;
-  return (size / sizeof(IC_PTR_ARRAY_ENTRY));
+  return (guint64)g_atomic_int_get(&dyn_ptr->next_index);
 }
 
 IC_DYNAMIC_PTR_ARRAY*
 ic_create_dynamic_ptr_array()
 {
-  IC_DYNAMIC_ARRAY_INT *dyn_array;
-  IC_PTR_ARRAY_ENTRY ptr_entry;
   IC_DYNAMIC_PTR_ARRAY_INT *dyn_ptr;
 
   DEBUG_ENTRY("ic_create_dynamic_ptr_array");
@@ -833,25 +824,12 @@ ic_create_dynamic_ptr_array()
       !(dyn_ptr= (IC_DYNAMIC_PTR_ARRAY_INT*)ic_calloc(
                       sizeof(IC_DYNAMIC_PTR_ARRAY_INT))))
     DEBUG_RETURN_PTR(NULL);
-  if (!(dyn_array= (IC_DYNAMIC_ARRAY_INT*)ic_create_ordered_dynamic_array()))
-  {
-    ic_free((void*)dyn_ptr);
-    DEBUG_RETURN_PTR(NULL);
-  }
-  ptr_entry.position= (guint64)0;
-  if (insert_ordered_dynamic_array((IC_DYNAMIC_ARRAY*)dyn_array,
-                                    (const gchar*)&ptr_entry,
-                                    sizeof(ptr_entry)))
-  {
-    ic_free((void*)dyn_ptr);
-    free_ordered_dynamic_array((IC_DYNAMIC_ARRAY*)dyn_array);
-    DEBUG_RETURN_PTR(NULL);
-  }
+  /* First index used is 1 */
+  dyn_ptr->next_index= 1;
   dyn_ptr->dpa_ops.ic_insert_ptr= insert_ptr;
   dyn_ptr->dpa_ops.ic_remove_ptr= remove_ptr;
   dyn_ptr->dpa_ops.ic_free_dynamic_ptr_array= free_dynamic_ptr_array;
   dyn_ptr->dpa_ops.ic_get_ptr= get_ptr;
   dyn_ptr->dpa_ops.ic_get_max_index= get_max_index;
-  dyn_ptr->dyn_array= dyn_array;
   DEBUG_RETURN_PTR((IC_DYNAMIC_PTR_ARRAY*)dyn_ptr);
 }
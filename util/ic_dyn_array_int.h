@@ -70,20 +70,35 @@ struct ic_dynamic_array_int
 };
 typedef struct ic_dynamic_array_int IC_DYNAMIC_ARRAY_INT;
 
-struct ic_ptr_array_entry
+/*
+  The dynamic pointer array is a table of segments where segment k has
+  IC_PTR_ARRAY_FIRST_SEGMENT_SIZE << k slots. The segment table has a
+  fixed size, so a segment never moves once it has been published and
+  lookups need no locks. Free slots are kept in a lock-free free list,
+  the head of the free list contains both the index of the first free
+  slot and a tag that is stepped on each change to avoid the ABA problem.
+*/
+#define IC_PTR_ARRAY_FIRST_SEGMENT_SIZE 256
+#define IC_PTR_ARRAY_MAX_SEGMENTS 15
+#define IC_PTR_ARRAY_INDEX_BITS 22
+#define IC_PTR_ARRAY_INDEX_MASK ((1 << IC_PTR_ARRAY_INDEX_BITS) - 1)
+#define IC_PTR_ARRAY_MAX_INDEX IC_PTR_ARRAY_INDEX_MASK
+
+struct ic_ptr_array_slot
 {
-  union
-  {
-    void *object;
-    guint64 position;
-  };
+  void *object;
+  volatile gint next_free;
 };
-typedef struct ic_ptr_array_entry IC_PTR_ARRAY_ENTRY;
+typedef struct ic_ptr_array_slot IC_PTR_ARRAY_SLOT;
 
 struct ic_dynamic_ptr_array_int
 {
   IC_DYNAMIC_PTR_ARRAY_OPS dpa_ops;
-  IC_DYNAMIC_ARRAY_INT *dyn_array;
+  IC_PTR_ARRAY_SLOT *segments[IC_PTR_ARRAY_MAX_SEGMENTS];
+  /* Next never used index */
+  volatile gint next_index;
+  /* Tag and index of the first free slot, index 0 means empty list */
+  volatile gint free_head;
 };
 typedef struct ic_dynamic_ptr_array_int IC_DYNAMIC_PTR_ARRAY_INT;
 #endif
@@ -408,6 +408,26 @@ ic_init_error_messages()
     "no default node section found in configuration";
   ic_error_str[IC_ERROR_NO_SUCH_NODE_TYPE - IC_FIRST_ERROR]=
     "incorrect node type given";
+  ic_error_str[IC_ERROR_KEY_NOT_DEFINED - IC_FIRST_ERROR]=
+    "not all key fields defined in key query";
+  ic_error_str[IC_ERROR_KEY_QUERY_TOO_BIG - IC_FIRST_ERROR]=
+    "key query too big to fit in one message";
+  ic_error_str[IC_ERROR_ILLEGAL_SCAN_PARAMETER - IC_FIRST_ERROR]=
+    "scan parallelism or batch size out of range";
+  ic_error_str[IC_ERROR_ILLEGAL_RANGE_DEFINITION - IC_FIRST_ERROR]=
+    "illegal definition of range condition";
+  ic_error_str[IC_ERROR_RANGE_TOO_BIG - IC_FIRST_ERROR]=
+    "range condition too big to fit in one message";
+  ic_error_str[IC_ERROR_ILLEGAL_WHERE_CONDITION - IC_FIRST_ERROR]=
+    "illegal definition of where condition";
+  ic_error_str[IC_ERROR_WHERE_CONDITION_TOO_BIG - IC_FIRST_ERROR]=
+    "where condition too big to compile into interpreted program";
+  ic_error_str[IC_ERROR_WHERE_CONDITION_NOT_PUSHABLE - IC_FIRST_ERROR]=
+    "where condition can't be executed in the data node";
+  ic_error_str[IC_ERROR_TRANSACTION_NOT_ACTIVE - IC_FIRST_ERROR]=
+    "commit or rollback already requested for the transaction";
+  ic_error_str[IC_ERROR_WHERE_CONDITION_NOT_SATISFIED - IC_FIRST_ERROR]=
+    "record read doesn't satisfy the where condition";
 #ifdef DEBUG
   /* Verify we have set an error message for all error codes */
   for (i= IC_FIRST_ERROR; i <= IC_LAST_ERROR; i++)
@@ -13,11 +13,17 @@
    along with this program; if not, write to the Free Software
    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA */
 
+/* cpu_set_t and sched_setaffinity are only defined with _GNU_SOURCE */
+#define _GNU_SOURCE
 #include <ic_base_header.h>
 #include <ic_port.h>
 #include <ic_debug.h>
 #include <ic_hw_info.h>
 #include <ic_string.h>
+#if defined(HAVE_SCHED_SETAFFINITY) || defined(HAVE_SCHED_GETCPU)
+#include <sched.h>
+#endif
+#include <errno.h>
 
 /**
   Get information about CPUs on this machine
@@ -344,3 +350,58 @@ no_info:
   *disk_space= 0;
   goto end;
 }
+
+/**
+  Bind the calling thread to a set of CPUs
+
+  @parameter cpu_ids            IN: Array of processor ids to bind to
+  @parameter num_cpus           IN: Number of processor ids in array
+
+  The processor ids are the ones reported by ic_get_cpu_info. Returns 0
+  on success and an OS error code if the binding failed or if binding
+  threads to CPUs isn't supported on this platform.
+*/
+int
+ic_bind_thread_to_cpus(guint32 *cpu_ids, guint32 num_cpus)
+{
+#ifdef HAVE_SCHED_SETAFFINITY
+  cpu_set_t cpu_set;
+  guint32 i;
+  int ret_code= 0;
+  DEBUG_ENTRY("ic_bind_thread_to_cpus");
+
+  CPU_ZERO(&cpu_set);
+  for (i= 0; i < num_cpus; i++)
+  {
+    if (cpu_ids[i] < CPU_SETSIZE)
+      CPU_SET(cpu_ids[i], &cpu_set);
+  }
+  if (CPU_COUNT(&cpu_set) == 0)
+    ret_code= EINVAL;
+  else if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set))
+    ret_code= errno;
+  DEBUG_PRINT(PORT_LEVEL, ("Bind thread to %u CPUs, ret_code: %d",
+                           num_cpus, ret_code));
+  DEBUG_RETURN_INT(ret_code);
+#else
+  (void)cpu_ids;
+  (void)num_cpus;
+  return ENOSYS;
+#endif
+}
+
+/**
+  Get the processor id of the CPU the calling thread currently executes
+  on. Returns IC_MAX_UINT32 when this isn't known.
+*/
+guint32
+ic_get_current_cpu()
+{
+#ifdef HAVE_SCHED_GETCPU
+  int cpu_id= sched_getcpu();
+
+  if (cpu_id >= 0)
+    return (guint32)cpu_id;
+#endif
+  return IC_MAX_UINT32;
+}
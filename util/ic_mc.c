@@ -244,3 +244,215 @@ ic_create_memory_container(guint32 base_size, guint32 max_size,
   mc_ptr->use_mutex= use_mutex;
   return (IC_MEMORY_CONTAINER*)mc_ptr;
 }
+
+/*
+  MODULE: Thread Memory Container
+  Description:
+    A memory container owned by one thread, it keeps its buffers at reset
+    to make the allocations after a reset as cheap as possible.
+*/
+static gchar**
+tmc_grow_buf_array(gchar **buf_array, guint32 *buf_array_size)
+{
+  gchar **new_buf_array;
+  guint32 new_size= 2 * (*buf_array_size);
+
+  if (!(new_buf_array= (gchar**)ic_calloc_mc(new_size * sizeof(gchar*))))
+    return NULL;
+  memcpy(new_buf_array, buf_array, (*buf_array_size) * sizeof(gchar*));
+  ic_free_mc(buf_array);
+  *buf_array_size= new_size;
+  return new_buf_array;
+}
+
+static gchar*
+tmc_alloc(IC_MEMORY_CONTAINER *ext_mc_ptr, guint32 size)
+{
+  IC_INT_THREAD_MEMORY_CONTAINER *mc_ptr=
+    (IC_INT_THREAD_MEMORY_CONTAINER*)ext_mc_ptr;
+  gchar **new_buf_array;
+  gchar *ret_ptr;
+  guint32 buf_inx;
+  guint64 new_total_size;
+
+  size= ic_align(size, 8); /* Always allocate on 8 byte boundaries */
+  new_total_size= mc_ptr->total_size + size;
+  if (mc_ptr->max_size > 0 && mc_ptr->max_size < new_total_size)
+    return NULL;
+  if (mc_ptr->current_free_len >= size)
+  {
+    /* Space is available, no need to allocate more */
+    ret_ptr= mc_ptr->current_buf;
+    mc_ptr->current_buf+= size;
+    mc_ptr->current_free_len-= size;
+    mc_ptr->total_size= new_total_size;
+    return ret_ptr;
+  }
+  if (size > mc_ptr->base_size)
+  {
+    /* Large allocations get their own buffer, current buffer remains */
+    if (mc_ptr->num_large_bufs == mc_ptr->large_buf_array_size)
+    {
+      if (!(new_buf_array= tmc_grow_buf_array(mc_ptr->large_buf_array,
+                                              &mc_ptr->large_buf_array_size)))
+        return NULL;
+      mc_ptr->large_buf_array= new_buf_array;
+    }
+    if (!(ret_ptr= ic_calloc_mc(size)))
+      return NULL;
+    mc_ptr->large_buf_array[mc_ptr->num_large_bufs++]= ret_ptr;
+    mc_ptr->total_size= new_total_size;
+    return ret_ptr;
+  }
+  buf_inx= mc_ptr->current_buf_inx + 1;
+  if (buf_inx == mc_ptr->num_bufs)
+  {
+    /* No buffer left from before the last reset, allocate a new one */
+    if (buf_inx == mc_ptr->buf_array_size)
+    {
+      if (!(new_buf_array= tmc_grow_buf_array(mc_ptr->buf_array,
+                                              &mc_ptr->buf_array_size)))
+        return NULL;
+      mc_ptr->buf_array= new_buf_array;
+    }
+    if (!(mc_ptr->buf_array[buf_inx]= ic_calloc_mc(mc_ptr->base_size)))
+      return NULL;
+    mc_ptr->num_bufs++;
+  }
+  mc_ptr->current_buf_inx= buf_inx;
+  ret_ptr= mc_ptr->buf_array[buf_inx];
+  mc_ptr->current_buf= ret_ptr + size;
+  mc_ptr->current_free_len= mc_ptr->base_size - size;
+  mc_ptr->total_size= new_total_size;
+  return ret_ptr;
+}
+
+static gchar*
+tmc_calloc(IC_MEMORY_CONTAINER *ext_mc_ptr, guint32 size)
+{
+  gchar *ptr;
+
+  if (!(ptr= tmc_alloc(ext_mc_ptr, size)))
+    return NULL;
+  ic_zero(ptr, size);
+  return ptr;
+}
+
+static void
+tmc_reset(IC_MEMORY_CONTAINER *ext_mc_ptr)
+{
+  IC_INT_THREAD_MEMORY_CONTAINER *mc_ptr=
+    (IC_INT_THREAD_MEMORY_CONTAINER*)ext_mc_ptr;
+  guint32 i;
+
+  for (i= 0; i < mc_ptr->num_large_bufs; i++)
+    ic_free_mc(mc_ptr->large_buf_array[i]);
+  mc_ptr->num_large_bufs= 0;
+  mc_ptr->current_buf_inx= 0;
+  mc_ptr->current_buf= mc_ptr->buf_array[0];
+  mc_ptr->current_free_len= mc_ptr->base_size;
+  mc_ptr->total_size= 0;
+}
+
+static void
+tmc_free(IC_MEMORY_CONTAINER *ext_mc_ptr)
+{
+  IC_INT_THREAD_MEMORY_CONTAINER *mc_ptr=
+    (IC_INT_THREAD_MEMORY_CONTAINER*)ext_mc_ptr;
+  guint32 i;
+
+  tmc_reset(ext_mc_ptr);
+  for (i= 0; i < mc_ptr->num_bufs; i++)
+    ic_free_mc(mc_ptr->buf_array[i]);
+  ic_free_mc(mc_ptr->buf_array);
+  ic_free_mc(mc_ptr->large_buf_array);
+  ic_free_mc(mc_ptr);
+}
+
+IC_MEMORY_CONTAINER*
+ic_create_thread_memory_container(guint32 base_size, guint32 max_size)
+{
+  IC_INT_THREAD_MEMORY_CONTAINER *mc_ptr;
+
+  if (base_size < MC_MIN_BASE_SIZE)
+    base_size= MC_MIN_BASE_SIZE;
+  base_size= ic_align(base_size, 8);
+  max_size= ic_align(max_size, 8);
+  if (max_size > 0 && max_size < base_size)
+    max_size= base_size;
+  if (!(mc_ptr= (IC_INT_THREAD_MEMORY_CONTAINER*)ic_calloc_mc(
+         sizeof(IC_INT_THREAD_MEMORY_CONTAINER))))
+    return NULL;
+  mc_ptr->buf_array_size= 8;
+  mc_ptr->large_buf_array_size= 8;
+  if (!(mc_ptr->buf_array= (gchar**)ic_calloc_mc(
+         mc_ptr->buf_array_size * sizeof(gchar*))) ||
+      !(mc_ptr->large_buf_array= (gchar**)ic_calloc_mc(
+         mc_ptr->large_buf_array_size * sizeof(gchar*))) ||
+      !(mc_ptr->buf_array[0]= ic_calloc_mc(base_size)))
+  {
+    if (mc_ptr->buf_array)
+      ic_free_mc(mc_ptr->buf_array);
+    if (mc_ptr->large_buf_array)
+      ic_free_mc(mc_ptr->large_buf_array);
+    ic_free_mc(mc_ptr);
+    return NULL;
+  }
+
+  /* Initialise methods */
+  mc_ptr->mc_ops.ic_mc_alloc= tmc_alloc;
+  mc_ptr->mc_ops.ic_mc_calloc= tmc_calloc;
+  mc_ptr->mc_ops.ic_mc_reset= tmc_reset;
+  mc_ptr->mc_ops.ic_mc_free= tmc_free;
+  /* Initialise Memory Container variables */
+  mc_ptr->num_bufs= 1;
+  mc_ptr->current_buf_inx= 0;
+  mc_ptr->current_buf= mc_ptr->buf_array[0];
+  mc_ptr->current_free_len= base_size;
+  mc_ptr->base_size= base_size;
+  mc_ptr->max_size= max_size;
+  mc_ptr->total_size= 0;
+  return (IC_MEMORY_CONTAINER*)mc_ptr;
+}
+
+#ifdef WITH_UNIT_TEST
+/*
+  Verify that a reset of a thread memory container keeps the base size
+  buffers for reuse and releases all large buffers.
+*/
+int
+ic_unit_test_thread_mc(void)
+{
+  IC_MEMORY_CONTAINER *ext_mc_ptr;
+  IC_INT_THREAD_MEMORY_CONTAINER *mc_ptr;
+  gchar *first_ptr;
+  guint32 i, num_bufs;
+  int ret_code= 1;
+
+  if (!(ext_mc_ptr= ic_create_thread_memory_container(1024, 0)))
+    return 1;
+  mc_ptr= (IC_INT_THREAD_MEMORY_CONTAINER*)ext_mc_ptr;
+  first_ptr= ext_mc_ptr->mc_ops.ic_mc_alloc(ext_mc_ptr, 512);
+  for (i= 0; i < 16; i++)
+  {
+    if (!ext_mc_ptr->mc_ops.ic_mc_alloc(ext_mc_ptr, 512) ||
+        !ext_mc_ptr->mc_ops.ic_mc_alloc(ext_mc_ptr, 4096))
+      goto end;
+  }
+  num_bufs= mc_ptr->num_bufs;
+  if (mc_ptr->num_large_bufs != 16 || num_bufs < 2)
+    goto end;
+  ext_mc_ptr->mc_ops.ic_mc_reset(ext_mc_ptr);
+  if (mc_ptr->num_large_bufs != 0 ||
+      mc_ptr->num_bufs != num_bufs ||
+      mc_ptr->total_size != 0)
+    goto end;
+  /* The first buffer is used first again */
+  if (ext_mc_ptr->mc_ops.ic_mc_alloc(ext_mc_ptr, 512) != first_ptr)
+    goto end;
+  ret_code= 0;
+end:
+  ext_mc_ptr->mc_ops.ic_mc_free(ext_mc_ptr);
+  return ret_code;
+}
+#endif
@@ -32,4 +32,27 @@ struct ic_int_memory_container
   IC_MUTEX *mutex;
 };
 typedef struct ic_int_memory_container IC_INT_MEMORY_CONTAINER;
+
+struct ic_int_thread_memory_container
+{
+  IC_MEMORY_CONTAINER_OPS mc_ops;
+  gchar *current_buf;
+  guint64 total_size;
+  guint64 max_size;
+  guint32 base_size;
+  guint32 current_free_len;
+  /*
+    Buffers of base size, buffers after current_buf_inx are not used since
+    the last reset and are reused before allocating new buffers.
+  */
+  gchar **buf_array;
+  guint32 buf_array_size;
+  guint32 num_bufs;
+  guint32 current_buf_inx;
+  /* Buffers larger than base size, these are released at reset */
+  gchar **large_buf_array;
+  guint32 large_buf_array_size;
+  guint32 num_large_bufs;
+};
+typedef struct ic_int_thread_memory_container IC_INT_THREAD_MEMORY_CONTAINER;
 #endif
@@ -0,0 +1,388 @@
+/* Copyright (C) 2026 iClaustron AB
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; version 2 of the License.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA */
+
+#include <ic_base_header.h>
+#include <ic_port.h>
+#include <ic_err.h>
+#include <ic_debug.h>
+#include <ic_oa_hashtable.h>
+
+/*
+  Implementation of the open addressing hash table using Robin Hood
+  hashing. An entry is placed at the first free slot after its home slot,
+  but on its way it takes over the slot of any entry that is closer to
+  its own home slot. Thus a search can stop as soon as it finds an entry
+  closer to its home slot than the searched key would be.
+
+  The control byte of a slot is 0 when the slot is empty and otherwise the
+  distance of the entry from its home slot plus one. Distances too large
+  for the control byte are saturated, the exact distance is always stored
+  in the entry.
+
+  Remove uses backward shift, the entries following the removed entry are
+  moved one slot back until an empty slot or an entry in its home slot is
+  found. So there are no tombstones.
+
+  When the table grows a new table of double size is allocated. The old
+  table is kept and on each insert and remove a number of its slots are
+  moved to the new table. Searches and removes look in both tables while
+  moving. Slots are moved a full cluster (sequence of non-empty slots) at
+  a time starting from an empty slot, this ensures that the clusters
+  remaining in the old table are intact and can be searched as usual.
+*/
+#define IC_OA_HASH_MIN_SIZE 16
+#define IC_OA_HASH_MAX_SIZE (1U << 30)
+#define IC_OA_HASH_MAX_CTRL 255
+#define IC_OA_HASH_MIGRATE_SLOTS 8
+#define IC_OA_HASH_CACHE_LINE_SIZE 64
+/* Grow the table when it's 80% full */
+#define IC_OA_HASH_LOAD_LIMIT(size) (((size) / 5) * 4)
+
+typedef struct ic_oa_hash_entry IC_OA_HASH_ENTRY;
+typedef struct ic_oa_hash_table IC_OA_HASH_TABLE;
+
+struct ic_oa_hash_entry
+{
+  void *key;
+  void *value;
+  guint32 hash_value;
+  guint32 dist;
+};
+
+struct ic_oa_hash_table
+{
+  guint8 *ctrl;
+  IC_OA_HASH_ENTRY *entries;
+  gchar *mem;
+  guint32 size;
+  guint32 num_entries;
+};
+
+struct ic_oa_hashtable
+{
+  IC_OA_HASH_TABLE table;
+  /* Table being moved to table, size is 0 when not moving */
+  IC_OA_HASH_TABLE old_table;
+  guint32 move_pos;
+  guint32 num_moved_slots;
+
+  guint32 entry_count;
+  guint32 load_limit;
+  unsigned int (*hash_fn) (void *key);
+  int (*key_eq_fn) (void *key1, void *key2);
+};
+
+static guint32
+get_hash_value(IC_OA_HASHTABLE *h, void *key)
+{
+  guint32 hash_value= h->hash_fn(key);
+
+  /*
+    The slot is taken from the lowest bits, mix all bits of the hash value
+    into them to protect against poor hash functions.
+  */
+  hash_value^= hash_value >> 16;
+  hash_value*= 0x85ebca6b;
+  hash_value^= hash_value >> 13;
+  hash_value*= 0xc2b2ae35;
+  hash_value^= hash_value >> 16;
+  return hash_value;
+}
+
+static int
+alloc_table(IC_OA_HASH_TABLE *table, guint32 size)
+{
+  gchar *mem;
+  gsize ctrl_addr;
+
+  /*
+    The control bytes are placed first, aligned on a cache line, the
+    entries follow, the size is a power of 2 and at least 16 so the
+    entries are properly aligned.
+  */
+  if (!(mem= ic_malloc(IC_OA_HASH_CACHE_LINE_SIZE - 1 +
+                       size * (sizeof(guint8) + sizeof(IC_OA_HASH_ENTRY)))))
+    return IC_ERROR_MEM_ALLOC;
+  ctrl_addr= ((gsize)mem + IC_OA_HASH_CACHE_LINE_SIZE - 1) &
+             ~((gsize)IC_OA_HASH_CACHE_LINE_SIZE - 1);
+  table->mem= mem;
+  table->ctrl= (guint8*)ctrl_addr;
+  table->entries= (IC_OA_HASH_ENTRY*)(table->ctrl + size);
+  table->size= size;
+  table->num_entries= 0;
+  memset(table->ctrl, 0, size);
+  return 0;
+}
+
+static void
+free_table(IC_OA_HASH_TABLE *table)
+{
+  if (table->mem)
+    ic_free(table->mem);
+  table->mem= NULL;
+  table->ctrl= NULL;
+  table->entries= NULL;
+  table->size= 0;
+  table->num_entries= 0;
+}
+
+static void
+set_slot(IC_OA_HASH_TABLE *table,
+         guint32 pos,
+         IC_OA_HASH_ENTRY *entry)
+{
+  table->entries[pos]= *entry;
+  table->ctrl[pos]= entry->dist < IC_OA_HASH_MAX_CTRL ?
+                    (guint8)(entry->dist + 1) : IC_OA_HASH_MAX_CTRL;
+}
+
+static guint32
+get_slot_dist(IC_OA_HASH_TABLE *table, guint32 pos)
+{
+  guint8 ctrl= table->ctrl[pos];
+
+  if (ctrl < IC_OA_HASH_MAX_CTRL)
+    return (guint32)(ctrl - 1);
+  return table->entries[pos].dist;
+}
+
+static void
+table_insert(IC_OA_HASH_TABLE *table, IC_OA_HASH_ENTRY *insert_entry)
+{
+  IC_OA_HASH_ENTRY entry= *insert_entry;
+  IC_OA_HASH_ENTRY swap_entry;
+  guint32 mask= table->size - 1;
+  guint32 pos= entry.hash_value & mask;
+
+  entry.dist= 0;
+  while (table->ctrl[pos])
+  {
+    if (get_slot_dist(table, pos) < entry.dist)
+    {
+      /* Take over the slot from an entry closer to its home */
+      swap_entry= table->entries[pos];
+      set_slot(table, pos, &entry);
+      entry= swap_entry;
+    }
+    pos= (pos + 1) & mask;
+    entry.dist++;
+  }
+  set_slot(table, pos, &entry);
+  table->num_entries++;
+}
+
+static gboolean
+table_search(IC_OA_HASHTABLE *h,
+             IC_OA_HASH_TABLE *table,
+             guint32 hash_value,
+             void *key,
+             guint32 *found_pos)
+{
+  guint32 mask, pos, dist;
+
+  if (table->size == 0)
+    return FALSE;
+  mask= table->size - 1;
+  pos= hash_value & mask;
+  for (dist= 0; table->ctrl[pos]; dist++)
+  {
+    if (get_slot_dist(table, pos) < dist)
+      break;
+    if (table->entries[pos].hash_value == hash_value &&
+        h->key_eq_fn(key, table->entries[pos].key))
+    {
+      *found_pos= pos;
+      return TRUE;
+    }
+    pos= (pos + 1) & mask;
+  }
+  return FALSE;
+}
+
+static void
+table_remove(IC_OA_HASH_TABLE *table, guint32 pos)
+{
+  guint32 mask= table->size - 1;
+  guint32 next_pos= (pos + 1) & mask;
+  IC_OA_HASH_ENTRY entry;
+
+  while (table->ctrl[next_pos] && get_slot_dist(table, next_pos) > 0)
+  {
+    entry= table->entries[next_pos];
+    entry.dist--;
+    set_slot(table, pos, &entry);
+    pos= next_pos;
+    next_pos= (next_pos + 1) & mask;
+  }
+  table->ctrl[pos]= 0;
+  table->num_entries--;
+}
+
+/*
+  Move at least num_slots slots from the old table to the table, we always
+  stop at an empty slot to ensure that we move full clusters.
+*/
+static void
+move_slots(IC_OA_HASHTABLE *h, guint32 num_slots)
+{
+  IC_OA_HASH_TABLE *old_table= &h->old_table;
+  guint32 mask;
+
+  if (old_table->size == 0)
+    return;
+  mask= old_table->size - 1;
+  while (h->num_moved_slots < old_table->size &&
+         (num_slots > 0 || old_table->ctrl[h->move_pos]))
+  {
+    if (old_table->ctrl[h->move_pos])
+    {
+      table_insert(&h->table, &old_table->entries[h->move_pos]);
+      old_table->ctrl[h->move_pos]= 0;
+      old_table->num_entries--;
+    }
+    h->move_pos= (h->move_pos + 1) & mask;
+    h->num_moved_slots++;
+    if (num_slots > 0)
+      num_slots--;
+  }
+  if (h->num_moved_slots == old_table->size)
+  {
+    ic_assert(old_table->num_entries == 0);
+    free_table(old_table);
+  }
+}
+
+static int
+grow_table(IC_OA_HASHTABLE *h)
+{
+  IC_OA_HASH_TABLE new_table;
+  guint32 pos;
+  int ret_code;
+
+  if (h->table.size >= IC_OA_HASH_MAX_SIZE)
+    return IC_ERROR_MEM_ALLOC;
+  /* Complete any ongoing move before starting a new one */
+  move_slots(h, h->old_table.size);
+  if ((ret_code= alloc_table(&new_table, 2 * h->table.size)))
+    return ret_code;
+  h->old_table= h->table;
+  h->table= new_table;
+  h->load_limit= IC_OA_HASH_LOAD_LIMIT(new_table.size);
+  /* Start moving at an empty slot, there is always one */
+  for (pos= 0; h->old_table.ctrl[pos]; pos++)
+    ;
+  h->move_pos= pos;
+  h->num_moved_slots= 0;
+  return 0;
+}
+
+IC_OA_HASHTABLE*
+ic_create_oa_hashtable(guint32 minsize,
+                       unsigned int (*hash_fn) (void*),
+                       int (*key_eq_fn) (void*, void*))
+{
+  IC_OA_HASHTABLE *h;
+  guint32 size= IC_OA_HASH_MIN_SIZE;
+
+  if (minsize > IC_OA_HASH_LOAD_LIMIT(IC_OA_HASH_MAX_SIZE))
+    return NULL;
+  while (IC_OA_HASH_LOAD_LIMIT(size) < minsize)
+    size*= 2;
+  if (!(h= (IC_OA_HASHTABLE*)ic_calloc(sizeof(IC_OA_HASHTABLE))))
+    return NULL;
+  if (alloc_table(&h->table, size))
+  {
+    ic_free(h);
+    return NULL;
+  }
+  h->load_limit= IC_OA_HASH_LOAD_LIMIT(size);
+  h->hash_fn= hash_fn;
+  h->key_eq_fn= key_eq_fn;
+  return h;
+}
+
+int
+ic_oa_hashtable_insert(IC_OA_HASHTABLE *h, void *key, void *value)
+{
+  IC_OA_HASH_ENTRY entry;
+
+  if (h->table.num_entries + h->old_table.num_entries >= h->load_limit &&
+      grow_table(h))
+  {
+    /*
+      We failed to grow the table, we can still insert as long as there is
+      at least one empty slot left in the table.
+    */
+    move_slots(h, h->old_table.size);
+    if (h->table.num_entries + 1 >= h->table.size)
+      return IC_ERROR_MEM_ALLOC;
+  }
+  move_slots(h, IC_OA_HASH_MIGRATE_SLOTS);
+  entry.key= key;
+  entry.value= value;
+  entry.hash_value= get_hash_value(h, key);
+  entry.dist= 0;
+  table_insert(&h->table, &entry);
+  h->entry_count++;
+  return 0;
+}
+
+void*
+ic_oa_hashtable_search(IC_OA_HASHTABLE *h, void *key)
+{
+  guint32 hash_value= get_hash_value(h, key);
+  guint32 pos;
+
+  if (table_search(h, &h->table, hash_value, key, &pos))
+    return h->table.entries[pos].value;
+  if (table_search(h, &h->old_table, hash_value, key, &pos))
+    return h->old_table.entries[pos].value;
+  return NULL;
+}
+
+void*
+ic_oa_hashtable_remove(IC_OA_HASHTABLE *h, void *key)
+{
+  guint32 hash_value= get_hash_value(h, key);
+  guint32 pos;
+  void *value;
+  IC_OA_HASH_TABLE *table;
+
+  if (table_search(h, &h->table, hash_value, key, &pos))
+    table= &h->table;
+  else if (table_search(h, &h->old_table, hash_value, key, &pos))
+    table= &h->old_table;
+  else
+    return NULL;
+  value= table->entries[pos].value;
+  table_remove(table, pos);
+  h->entry_count--;
+  move_slots(h, IC_OA_HASH_MIGRATE_SLOTS);
+  return value;
+}
+
+guint32
+ic_oa_hashtable_count(IC_OA_HASHTABLE *h)
+{
+  return h->entry_count;
+}
+
+void
+ic_oa_hashtable_destroy(IC_OA_HASHTABLE *h)
+{
+  free_table(&h->table);
+  free_table(&h->old_table);
+  ic_free(h);
+}
@@ -18,6 +18,7 @@
 #include <ic_err.h>
 #include <ic_debug.h>
 #include <ic_threadpool.h>
+#include <ic_hw_info.h>
 #include "ic_threadpool_int.h"
 
 /* Key to thread local storage for thread pool */
@@ -71,6 +72,10 @@ free_threadpool(IC_INT_THREADPOOL_STATE *tp_state)
   {
     ic_mutex_destroy(&tp_state->free_list_mutex);
   }
+  if (tp_state->cpu_ids)
+  {
+    ic_free((void*)tp_state->cpu_ids);
+  }
   ic_free((void*)tp_state);
   DEBUG_RETURN_EMPTY;
 }
@@ -665,6 +670,66 @@ stop_thread_wait(IC_THREADPOOL_STATE *ext_tp_state, guint32 thread_id)
   DEBUG_RETURN_EMPTY;
 }
 
+static int
+set_cpus(IC_THREADPOOL_STATE *ext_tp_state,
+         guint32 *cpu_ids,
+         guint32 num_cpus,
+         gboolean dedicated_cpus)
+{
+  IC_INT_THREADPOOL_STATE *tp_state= (IC_INT_THREADPOOL_STATE*)ext_tp_state;
+  guint32 *new_cpu_ids= NULL;
+  guint32 *old_cpu_ids;
+  DEBUG_ENTRY("set_cpus");
+  DEBUG_PRINT(THREAD_LEVEL, ("Pool: %s, num_cpus: %u, dedicated: %u",
+                             tp_state->pool_name, num_cpus, dedicated_cpus));
+
+  if (num_cpus)
+  {
+    if (!(new_cpu_ids= (guint32*)ic_malloc(num_cpus * sizeof(guint32))))
+      DEBUG_RETURN_INT(IC_ERROR_MEM_ALLOC);
+    memcpy(new_cpu_ids, cpu_ids, num_cpus * sizeof(guint32));
+  }
+  ic_mutex_lock(tp_state->free_list_mutex);
+  old_cpu_ids= tp_state->cpu_ids;
+  tp_state->cpu_ids= new_cpu_ids;
+  tp_state->num_cpus= num_cpus;
+  tp_state->next_cpu_inx= 0;
+  tp_state->dedicated_cpus= dedicated_cpus;
+  ic_mutex_unlock(tp_state->free_list_mutex);
+  if (old_cpu_ids)
+    ic_free((void*)old_cpu_ids);
+  DEBUG_RETURN_INT(0);
+}
+
+/* Bind the calling thread according to the CPUs set on the pool */
+static void
+bind_thread_cpus(IC_INT_THREADPOOL_STATE *tp_state)
+{
+  guint32 cpu_id;
+  int ret_code= 0;
+
+  ic_mutex_lock(tp_state->free_list_mutex);
+  if (tp_state->num_cpus)
+  {
+    if (tp_state->dedicated_cpus)
+    {
+      cpu_id= tp_state->cpu_ids[tp_state->next_cpu_inx];
+      tp_state->next_cpu_inx= (tp_state->next_cpu_inx + 1) %
+                              tp_state->num_cpus;
+      ret_code= ic_bind_thread_to_cpus(&cpu_id, 1);
+    }
+    else
+      ret_code= ic_bind_thread_to_cpus(tp_state->cpu_ids,
+                                       tp_state->num_cpus);
+  }
+  ic_mutex_unlock(tp_state->free_list_mutex);
+  if (ret_code)
+  {
+    DEBUG_PRINT(THREAD_LEVEL, ("Failed to bind thread in pool %s, error %d",
+                               tp_state->pool_name, ret_code));
+  }
+}
+
 /*
   This method is used by the thread managed by the thread pool when it
   has completed its startup handling. This method is called if and only
@@ -678,6 +743,7 @@ thread_started(IC_THREAD_STATE *ext_thread_state)
   DEBUG_PRINT(THREAD_LEVEL, ("thread_id: %d", thread_state->thread_id));
 
   g_private_set(&thread_priv, (void*)thread_state->tp_state);
+  bind_thread_cpus(thread_state->tp_state);
   /* By locking the mutex we ensure that start synch is done */
   ic_mutex_lock(thread_state->mutex);
   thread_state->started= TRUE;
@@ -855,6 +921,7 @@ ic_create_threadpool(guint32 pool_size,
   tp_state->tp_ops.ic_threadpool_get_stop_flag= tp_get_stop_flag;
   tp_state->tp_ops.ic_threadpool_set_stop_flag= set_stop_flag;
   tp_state->tp_ops.ic_threadpool_stop= stop_threadpool;
+  tp_state->tp_ops.ic_threadpool_set_cpus= set_cpus;
 
   /* Thread state functions */
   tp_state->ts_ops.ic_thread_stops= thread_stops;
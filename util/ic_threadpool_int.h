@@ -152,4 +152,13 @@ struct ic_int_threadpool_state
   /* Memory allocation variable for all the thread state objects */
   gchar *thread_state_allocation;
   gchar *pool_name;
+  /*
+    CPUs the threads of the pool are bound to, num_cpus is 0 when threads
+    aren't bound. With dedicated_cpus each thread gets one CPU, the next
+    one handed out is next_cpu_inx. Protected by the free list mutex.
+  */
+  guint32 *cpu_ids;
+  guint32 num_cpus;
+  guint32 next_cpu_inx;
+  gboolean dedicated_cpus;
 };